@@ -17,13 +17,22 @@
 # include "files.h"
 # include "actions.h"
 # include "parser.h"
+# include "metadata.h"
+# include "config.h"
+# include "compress.h"
+# include "stage.h"
+# include "walk.h"
+# include "snapshot.h"
+# include "status.h"
+# include "monitor.h"
+# include "journal.h"
 
 /**
  * @brief Initializes a new VCS repository.
  *
  * This function creates the necessary directory and files for a new VCS repository.
  * It checks if the ".vcs" directory already exists, and if not, creates it along
- * with the required files: "commits.txt", "stage.txt", "contents.txt", and "metadata.txt".
+ * with the required files: "commits.txt", "stage.idx", "contents.txt", "metadata.idx", "blobs.txt", and "config.txt".
  *
  * @note This function terminates the program if the directory or files cannot be created.
  */
@@ -46,9 +55,9 @@ void vcs_init() {
         exit(EXIT_FAILURE);
     }
 
-    // Create .vcs/stage.txt file
-    if (write_empty_file(STAGE_FILE) == 0) {
-        printf("vcs: error: could not create .vcs/stage.txt file\n");
+    // Create .vcs/stage.idx file
+    if (stage_create(STAGE_FILE) == 0) {
+        printf("vcs: error: could not create .vcs/stage.idx file\n");
         exit(EXIT_FAILURE);
     }
 
@@ -58,9 +67,25 @@ void vcs_init() {
         exit(EXIT_FAILURE);
     }
 
-    // Create .vcs/metadata.txt file
-    if (write_empty_file(METADATA_FILE) == 0) {
-        printf("vcs: error: could not create .vcs/metadata.txt file\n");
+    // Create .vcs/metadata.idx file
+    if (metadata_create(METADATA_FILE) == 0) {
+        printf("vcs: error: could not create .vcs/metadata.idx file\n");
+        exit(EXIT_FAILURE);
+    }
+
+    // Create .vcs/blobs.txt file
+    if (write_empty_file(BLOBS_FILE) == 0) {
+        printf("vcs: error: could not create .vcs/blobs.txt file\n");
+        exit(EXIT_FAILURE);
+    }
+
+    // Create .vcs/config.txt file, blob records start at the beginning of contents
+    if (config_set(CONFIG_FRAMED_SINCE, 0) == 0) {
+        printf("vcs: error: could not create .vcs/config.txt file\n");
+        exit(EXIT_FAILURE);
+    }
+    if (config_set(CONFIG_COMPRESSION_LEVEL, COMPRESS_LEVEL_DEFAULT) == 0) {
+        printf("vcs: error: could not write .vcs/config.txt file\n");
         exit(EXIT_FAILURE);
     }
 
@@ -68,49 +93,168 @@ void vcs_init() {
 }
 
 /**
- * @brief Adds a file to the VCS stage.
+ * @brief Reports the result of staging one file.
+ *
+ * @param path The path of the file.
+ * @param result The result of stage_set.
+ */
+static void report_staged(const char *path, int result) {
+    if (result == STAGE_ADDED) {
+        printf("vcs: %s added to stage\n", path);
+    } else if (result == STAGE_UPDATED) {
+        printf("vcs: %s updated in stage\n", path);
+    } else {
+        printf("vcs: %s is unchanged in stage\n", path);
+    }
+}
+
+/**
+ * @brief Adds files to the VCS stage.
  *
- * This function adds a file to the VCS stage by appending its path to the "stage.txt" file
- * in the ".vcs" directory. It performs various validations such as checking if the ".vcs"
- * directory exists, if the provided path exists, and if the file has already been added to the stage.
+ * This function adds files to the VCS stage by storing their current content in the blob store
+ * and recording each path with its blob in the "stage.idx" index in the ".vcs" directory, so later
+ * edits do not leak into the commit. The ".vcs" directory is validated and the stage is loaded once
+ * for the whole batch, and the new stage is written back in a single atomic write. Adding a staged
+ * file again updates its blob if the content changed and does nothing otherwise; paths that do not
+ * exist are reported and skipped. A directory adds every regular file under it, found by a parallel walk.
+ * The files of all paths are stored together, read and encoded by a pool of threads and written in order.
  *
- * @param path The path of the file to be added to the stage.
+ * @param paths The paths of the files and directories to be added to the stage.
+ * @param count The number of paths.
+ * @return The number of paths added to the stage or updated in it.
  *
- * @note This function terminates the program if any validation fails or if the file cannot be appended to the stage.
+ * @note This function terminates the program if validation fails, if the stage cannot be written,
+ * or, after writing the stage, if any path was skipped.
  */
-void vcs_add(const char *path) {
+size_t vcs_add(const char *const *paths, size_t count) {
     // validate .vcs directory
     if (validate_directory(VCS_DIRECTORY) == 0) {
         printf("vcs: error: .vcs was not initialized\n");
         exit(EXIT_FAILURE);
     }
 
-    // verifies if path was provided
-    if (path == NULL) {
+    // repair what an interrupted command left behind
+    if (journal_recover(1) == 0) {
+        exit(EXIT_FAILURE);
+    }
+
+    // verifies if paths were provided
+    if (count == 0) {
         printf("vcs: error: no path provided\n");
         exit(EXIT_FAILURE);
     }
 
-    // verifies if path exists
-    if (file_exists(path) == 0) {
-        printf("vcs: error: %s file not found\n", path);
+    // load stage index in the command arena
+    Arena *arena = arena_create();
+    Stage *stage = stage_load(arena);
+    if (stage == NULL) {
         exit(EXIT_FAILURE);
     }
+    Snapshot *snapshot = snapshot_open(arena);
+
+    // gather the files of every path, so they are all stored in one pipeline
+    size_t *firsts = (size_t *)arena_alloc(arena, (count + 1) * sizeof(size_t));
+    size_t *founds = (size_t *)arena_alloc(arena, (count + 1) * sizeof(size_t));
+    char ***groups = (char ***)arena_alloc(arena, (count + 1) * sizeof(char **));
+    int *directories = (int *)arena_alloc(arena, (count + 1) * sizeof(int));
+    char **names = (char **)arena_alloc(arena, (count + 1) * sizeof(char *));
+    if (firsts == NULL || founds == NULL || groups == NULL || directories == NULL || names == NULL) {
+        printf("vcs: error: could not allocate memory for stage\n");
+        exit(EXIT_FAILURE);
+    }
+    size_t total = 0;
+    int skipped = 0;
+    for (size_t i = 0; i < count; i++) {
+        groups[i] = NULL;
+        founds[i] = 0;
+        directories[i] = 0;
+
+        // verifies if path exists
+        if (file_exists(paths[i]) == 0) {
+            printf("vcs: error: %s file not found\n", paths[i]);
+            skipped = 1;
+            continue;
+        }
+
+        // stage paths as the walk writes them, so each file has one name
+        names[i] = walk_normalize(paths[i], arena);
+        if (names[i] == NULL) {
+            printf("vcs: error: could not allocate memory for stage\n");
+            exit(EXIT_FAILURE);
+        }
+
+        // a directory stands for the files under it
+        if (is_directory(names[i]) == 1) {
+            directories[i] = 1;
+            groups[i] = walk_directory(names[i], arena, &founds[i]);
+            if (groups[i] == NULL) {
+                exit(EXIT_FAILURE);
+            }
+        } else {
+            groups[i] = &names[i];
+            founds[i] = 1;
+        }
+        firsts[i] = total;
+        total += founds[i];
+    }
+    char **files = (char **)arena_alloc(arena, (total + 1) * sizeof(char *));
+    Blob *blobs = (Blob *)arena_alloc(arena, (total + 1) * sizeof(Blob));
+    if (files == NULL || blobs == NULL) {
+        printf("vcs: error: could not allocate memory for stage\n");
+        exit(EXIT_FAILURE);
+    }
+    for (size_t i = 0; i < count; i++) {
+        if (founds[i] > 0) {
+            memcpy(files + firsts[i], groups[i], founds[i] * sizeof(char *));
+        }
+    }
+    stage_reserve(stage, stage->count + total);
+
+    // store the content of every file as it is now
+    snapshot_files(snapshot, files, total, blobs);
+
+    size_t added = 0;
+    for (size_t i = 0; i < count; i++) {
+        if (groups[i] == NULL) {
+            continue;
+        }
+        size_t staged = 0;
+        for (size_t j = firsts[i]; j < firsts[i] + founds[i]; j++) {
+            if (blobs[j].digest[0] == '\0') {
+                printf("vcs: error: could not store %s\n", files[j]);
+                skipped = 1;
+                continue;
+            }
+            int result = stage_set(stage, files[j], &blobs[j]);
+            if (!directories[i]) {
+                report_staged(files[j], result);
+            }
+            staged += (result != STAGE_UNCHANGED);
+        }
+        if (directories[i]) {
+            printf("vcs: %zu files in %s added to stage\n", staged, paths[i]);
+        }
+        added += staged;
+    }
+    snapshot_close(snapshot);
 
-    // verifies if path was already added
-    if (path_is_staged(path) == 1) {
-        printf("vcs: error: %s was already added to stage\n", path);
+    // stored contents must be on disk before the stage refers to them
+    const char *stored[] = { CONTENTS_FILE, BLOBS_FILE, VCS_DIRECTORY };
+    if (added > 0 && journal_sync(stored, sizeof(stored) / sizeof(stored[0])) == 0) {
         exit(EXIT_FAILURE);
     }
 
-    // append path to .vcs/stage.txt
-    if (append_to_file(STAGE_FILE, path) == 0) {
-        printf("vcs: error: could not append to .vcs/stage.txt\n");
+    // write .vcs/stage.idx once for the batch
+    if (added > 0 && stage_save(stage) == 0) {
+        printf("vcs: error: could not write .vcs/stage.idx\n");
         exit(EXIT_FAILURE);
     }
+    arena_destroy(arena);
 
-    // print success message
-    printf("vcs: %s added to stage\n", path);
+    if (skipped) {
+        exit(EXIT_FAILURE);
+    }
+    return added;
 }
 
 /**
@@ -132,39 +276,55 @@ void vcs_commit(const char *message) {
         exit(EXIT_FAILURE);
     }
 
+    // repair what an interrupted command left behind
+    if (journal_recover(1) == 0) {
+        exit(EXIT_FAILURE);
+    }
+
     // verifies if message was provided
     if (message == NULL) {
         printf("vcs: error: no message provided\n");
         exit(EXIT_FAILURE);
     }
 
+    // load stage index in the command arena
+    Arena *arena = arena_create();
+    Stage *stage = stage_load(arena);
+    if (stage == NULL) {
+        exit(EXIT_FAILURE);
+    }
+
     // verifies if stage is empty
-    if (file_is_empty(STAGE_FILE) == 1) {
+    if (stage->count == 0) {
         printf("vcs: error: stage is empty\n");
         exit(EXIT_FAILURE);
     }
 
-    // initialize commit head and files head
-    CommitHead *commit_head = commit_create();
-    FileHead *file_head = file_create();
+    // initialize commit and file tables in the command arena
+    CommitTable *table = commit_table_create(arena);
+    FileTable *files = file_table_create(arena);
 
-    // read stage file
-    parse_stage(file_head);
+    // store staged files
+    parse_stage(stage, files);
 
     // parse commit file
-    parse_commit_file(commit_head, file_head, message);
+    parse_commit_file(table, files, message);
 
     // display structs 
-    commit_display(commit_head);
+    commit_display(table);
 
-    file_display(file_head);
+    file_display(files);
 
-    // rewrite stage file
-    write_empty_file(STAGE_FILE);
+    // empty the stage index, or the next commit would record the same entries again
+    stage_clear(stage);
+    if (stage_save(stage) == 0) {
+        printf("vcs: error: commit was recorded but could not empty .vcs/stage.idx\n");
+        exit(EXIT_FAILURE);
+    }
 
     // free memory
-    commit_destroy(commit_head);
-    file_destroy(file_head);
+    commit_table_destroy(table);
+    arena_destroy(arena);
 
     // print success message
     printf("vcs: commit successful\n");
@@ -186,17 +346,24 @@ void vcs_log(void) {
         exit(EXIT_FAILURE);
     }
 
-    // initialize commit head and files head
-    CommitHead *commit_head = commit_create();
+    // repair what an interrupted command left behind
+    if (journal_recover(0) == 0) {
+        exit(EXIT_FAILURE);
+    }
+
+    // initialize commit and file tables in the command arena
+    Arena *arena = arena_create();
+    CommitTable *table = commit_table_create(arena);
 
     // parse commits file to data structure
-    parse_commits(commit_head);
+    parse_commits(table);
 
     // display commits
-    display_from_last(commit_head);
+    display_from_last(table);
 
     // free memory
-    commit_destroy(commit_head);
+    commit_table_destroy(table);
+    arena_destroy(arena);
 
     // print success message
     printf("vcs: log successful\n");
@@ -218,17 +385,24 @@ void vcs_log_content(void) {
         exit(EXIT_FAILURE);
     }
 
-    // initialize commit head and files head
-    CommitHead *commit_head = commit_create();
+    // repair what an interrupted command left behind
+    if (journal_recover(0) == 0) {
+        exit(EXIT_FAILURE);
+    }
+
+    // initialize commit and file tables in the command arena
+    Arena *arena = arena_create();
+    CommitTable *table = commit_table_create(arena);
 
     // parse commits file to data structure
-    parse_commits(commit_head);
+    parse_commits(table);
 
     // display commits with contents
-    display_from_last_with_contents(commit_head);
+    display_from_last_with_contents(table);
 
     // free memory
-    commit_destroy(commit_head);
+    commit_table_destroy(table);
+    arena_destroy(arena);
 
     // print success message
     printf("vcs: log successful\n");
@@ -239,8 +413,8 @@ void vcs_log_content(void) {
  * @brief Checks out to a specific commit.
  *
  * This function checks out to a specific commit by writing the commit and contents associated with
- * the provided commit hash. It validates the ".vcs" directory, parses the commits file, and verifies
- * if a hash is provided. If successful, it writes the commit and contents files to the current working directory.
+ * the provided commit hash. It validates the ".vcs" directory, verifies if a hash is provided, and
+ * looks the commit up in the sorted commit index, reading only that commit from the commits file. If successful, it writes the commit and contents files to the current working directory.
  *
  * @param hash The hash of the commit to check out to.
  *
@@ -253,11 +427,11 @@ void vcs_checkout(const char *hash) {
         printf("vcs: error: .vcs was not initialized\n");
         exit(EXIT_FAILURE);
     }
-    // initialize commit head and files head
-    CommitHead *commit_head = commit_create();
 
-    // parse commits file to data structure
-    parse_commits(commit_head);
+    // repair what an interrupted command left behind
+    if (journal_recover(0) == 0) {
+        exit(EXIT_FAILURE);
+    }
 
     // verify if hash is NULL
     if (hash == NULL) {
@@ -265,18 +439,36 @@ void vcs_checkout(const char *hash) {
         exit(EXIT_FAILURE);
     }
 
+    // initialize commit table in the command arena
+    Arena *arena = arena_create();
+    CommitTable *table = commit_table_create(arena);
+
+    // look up the commit in the commit index
+    if (parse_commit_by_hash(table, hash) == 0) {
+        printf("Commit not found!\n");
+        commit_table_destroy(table);
+        arena_destroy(arena);
+        return;
+    }
+
     // checkout to hash
-    write_commit_and_contents(commit_head, hash);
+    int written = write_commit_and_contents(table, table->count - 1);
 
     // free memory
-    commit_destroy(commit_head);
+    commit_table_destroy(table);
+    arena_destroy(arena);
+
+    if (written == 0) {
+        printf("vcs: error: could not write every file of the commit\n");
+        exit(EXIT_FAILURE);
+    }
 }
 
 /**
  * @brief Checks out to the current commit.
  *
  * This function checks out to the current commit by writing the commit and contents associated with
- * the most recent commit. It validates the ".vcs" directory, parses the commits file, and checks out
+ * the most recent commit. It validates the ".vcs" directory, parses the last metadata record, and checks out
  * to the most recent commit by writing the commit and contents files to the current working directory.
  * 
  * @note This function terminates the program if the ".vcs" directory is not valid or if the commit and contents cannot be written.
@@ -287,25 +479,42 @@ void vcs_checkout_current(void) {
         printf("vcs: error: .vcs was not initialized\n");
         exit(EXIT_FAILURE);
     }
-    // initialize commit head and files head
-    CommitHead *commit_head = commit_create();
 
-    // parse commits file to data structure
-    parse_commits(commit_head);
+    // repair what an interrupted command left behind
+    if (journal_recover(0) == 0) {
+        exit(EXIT_FAILURE);
+    }
+    // initialize commit table in the command arena
+    Arena *arena = arena_create();
+    CommitTable *table = commit_table_create(arena);
+
+    // parse the most recent commit only
+    if (parse_last_commit(table) == 0) {
+        printf("vcs: error: no commits yet\n");
+        commit_table_destroy(table);
+        arena_destroy(arena);
+        exit(EXIT_FAILURE);
+    }
 
     // checkout to hash
-    write_commit_and_contents(commit_head, commit_head->last->hash);
+    int written = write_commit_and_contents(table, table->count - 1);
 
     // free memory
-    commit_destroy(commit_head);
+    commit_table_destroy(table);
+    arena_destroy(arena);
+
+    if (written == 0) {
+        printf("vcs: error: could not write every file of the commit\n");
+        exit(EXIT_FAILURE);
+    }
 }
 
 /**
  * @brief Displays the details of a specific commit.
  *
- * This function displays the details of a specific commit by parsing the "commits.txt" file and
- * finding the commit with the provided hash. It validates the ".vcs" directory, parses the commits,
- * and prints the commit information along with its contents.
+ * This function displays the details of a specific commit by looking up the provided hash in the
+ * sorted commit index and reading only that commit from the "commits.txt" file. It validates the
+ * ".vcs" directory and prints the commit information along with its contents.
  *
  * @param hash The hash of the commit to display.
  *
@@ -319,11 +528,10 @@ void vcs_show(const char *hash) {
         exit(EXIT_FAILURE);
     }
 
-    // initialize commit head and files head
-    CommitHead *commit_head = commit_create();
-
-    // parse commits file to data structure
-    parse_commits(commit_head);
+    // repair what an interrupted command left behind
+    if (journal_recover(0) == 0) {
+        exit(EXIT_FAILURE);
+    }
 
     // verify if hash is NULL
     if (hash == NULL) {
@@ -331,10 +539,104 @@ void vcs_show(const char *hash) {
         exit(EXIT_FAILURE);
     }
 
+    // initialize commit table in the command arena
+    Arena *arena = arena_create();
+    CommitTable *table = commit_table_create(arena);
+
+    // look up the commit in the commit index
+    if (parse_commit_by_hash(table, hash) == 0) {
+        printf("Commit not found!\n");
+        commit_table_destroy(table);
+        arena_destroy(arena);
+        return;
+    }
+
     // display commit and contents
-    display_commit_and_contents(commit_head, hash);
+    display_commit_and_contents(table, table->count - 1);
 
     // free memory
-    commit_destroy(commit_head);
+    commit_table_destroy(table);
+    arena_destroy(arena);
 
 }
+
+/**
+ * @brief Displays the status of the working tree.
+ *
+ * This function compares the committed files, the stage and the working tree, and prints
+ * the staged changes, the changes that are not staged and the files that are not tracked. Only files
+ * whose stat data changed since their digest was last recorded are read.
+ *
+ * @note This function terminates the program if the ".vcs" directory is not valid or if the stage
+ * or the stat cache cannot be loaded.
+ */
+void vcs_status(void) {
+    // validate .vcs directory
+    if (validate_directory(VCS_DIRECTORY) == 0) {
+        printf("vcs: error: .vcs was not initialized\n");
+        exit(EXIT_FAILURE);
+    }
+
+    // repair what an interrupted command left behind
+    if (journal_recover(0) == 0) {
+        exit(EXIT_FAILURE);
+    }
+
+    // load stage, every commit and stat cache in the command arena
+    Arena *arena = arena_create();
+    Stage *stage = stage_load(arena);
+    if (stage == NULL) {
+        exit(EXIT_FAILURE);
+    }
+    CommitTable *head = commit_table_create(arena);
+    parse_commits(head);
+    StatCache *cache = stat_cache_load(arena);
+    if (cache == NULL) {
+        exit(EXIT_FAILURE);
+    }
+
+    // paths changed since the last status, if a monitor is running
+    MonitorChanges *changes = monitor_query(arena);
+
+    // compare the three versions of every file
+    int printed = status_print(head, stage, cache, changes);
+
+    // free memory
+    commit_table_destroy(head);
+    arena_destroy(arena);
+
+    if (printed == 0) {
+        exit(EXIT_FAILURE);
+    }
+    printf("vcs: status successful\n");
+}
+
+/**
+ * @brief Starts or stops the file system monitor of the repository.
+ *
+ * The monitor watches the working tree in the background, so status only needs to look at
+ * the files that changed since it last ran.
+ *
+ * @param stop 1 to stop the running monitor, 0 to start one.
+ *
+ * @note This function terminates the program if the ".vcs" directory is not valid or if the
+ * monitor cannot be started or stopped.
+ */
+void vcs_monitor(int stop) {
+    // validate .vcs directory
+    if (validate_directory(VCS_DIRECTORY) == 0) {
+        printf("vcs: error: .vcs was not initialized\n");
+        exit(EXIT_FAILURE);
+    }
+
+    if (stop) {
+        if (monitor_stop() == 0) {
+            exit(EXIT_FAILURE);
+        }
+        printf("vcs: monitor stopped\n");
+        return;
+    }
+    if (monitor_start() == 0) {
+        exit(EXIT_FAILURE);
+    }
+}
@@ -1,13 +1,17 @@
 # ifndef __ACTIONS_H__
 # define __ACTIONS_H__
 
+# include <stddef.h>
+
 void vcs_init();
-void vcs_add(const char *path);
+size_t vcs_add(const char *const *paths, size_t count);
 void vcs_commit(const char *message);
 void vcs_log(void);
 void vcs_log_content(void);
 void vcs_checkout(const char *hash);
 void vcs_checkout_current(void);
 void vcs_show(const char *hash);
+void vcs_status(void);
+void vcs_monitor(int stop);
 
 # endif
\ No newline at end of file
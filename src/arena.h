@@ -0,0 +1,37 @@
+# ifndef __ARENA_H__
+# define __ARENA_H__
+
+# include <stddef.h>
+
+/// Settings
+# define ARENA_BLOCK_SIZE 65536
+# define ARENA_ALIGNMENT 16
+
+typedef struct arena_block ArenaBlock;
+typedef struct arena Arena;
+
+struct arena_block {
+    ArenaBlock* next;
+    size_t size;
+    size_t used;
+};
+
+/**
+ * Bump allocator that owns everything allocated from it until it is
+ * destroyed. The counters record how many allocations it served and how
+ * many blocks it needed from malloc for them.
+ */
+struct arena {
+    ArenaBlock* blocks;
+    size_t allocations;
+    size_t bytes;
+    size_t block_count;
+};
+
+// function prototypes
+Arena* arena_create();
+void* arena_alloc(Arena* arena, size_t size);
+char* arena_strdup(Arena* arena, const char* string);
+void arena_destroy(Arena* arena);
+
+# endif
@@ -0,0 +1,500 @@
+/**
+ * @file blobs.c
+ * @brief Content-addressed blob store for the VCS (Version Control System).
+ *
+ * File contents are appended to the contents file as a blob record once per
+ * distinct SHA-256 digest. The blobs file maps each digest to its byte range, so a commit that
+ * stages unchanged content points at the existing blob instead of copying it.
+ * Changed content is stored as a delta against the previous version of the
+ * same path when the delta is small enough. Large files are streamed and
+ * split into content-defined chunks that are deduplicated the same way.
+ */
+# include <stdio.h>
+# include <stdlib.h>
+# include <string.h>
+# include <inttypes.h>
+
+# include "validations.h"
+# include "files.h"
+# include "config.h"
+# include "chunk.h"
+# include "compress.h"
+# include "delta.h"
+# include "contents.h"
+# include "blobs.h"
+
+/**
+ * @brief Computes the home slot of a digest in the index table.
+ *
+ * @param index The blob index.
+ * @param digest The hexadecimal digest.
+ * @return The slot position.
+ */
+static size_t blob_slot(BlobIndex* index, const char* digest) {
+    char prefix[17];
+    memcpy(prefix, digest, 16);
+    prefix[16] = '\0';
+    return (size_t)strtoull(prefix, NULL, 16) & (index->capacity - 1);
+}
+
+/**
+ * @brief Inserts an entry into the table, growing it when it is half full.
+ *
+ * @param index The blob index.
+ * @param digest The hexadecimal digest.
+ * @param start_byte The start byte of the blob in the contents file.
+ * @param end_byte The end byte of the blob in the contents file.
+ * @return A pointer to the stored entry, or NULL on allocation failure.
+ */
+Blob* blob_index_insert(BlobIndex* index, const char* digest, int64_t start_byte, int64_t end_byte) {
+    if ((index->count + 1) * 2 > index->capacity) {
+        size_t old_capacity = index->capacity;
+        Blob* old_entries = index->entries;
+
+        index->capacity = old_capacity * 2;
+        index->entries = calloc(index->capacity, sizeof(Blob));
+        if (index->entries == NULL) {
+            index->entries = old_entries;
+            index->capacity = old_capacity;
+            return NULL;
+        }
+        index->count = 0;
+
+        // rehash existing entries
+        for (size_t i = 0; i < old_capacity; i++) {
+            if (old_entries[i].digest[0] != '\0') {
+                blob_index_insert(index, old_entries[i].digest, old_entries[i].start_byte, old_entries[i].end_byte);
+            }
+        }
+        free(old_entries);
+    }
+
+    size_t slot = blob_slot(index, digest);
+    while (index->entries[slot].digest[0] != '\0') {
+        if (strcmp(index->entries[slot].digest, digest) == 0) {
+            return &index->entries[slot];
+        }
+        slot = (slot + 1) & (index->capacity - 1);
+    }
+
+    Blob* blob = &index->entries[slot];
+    strcpy(blob->digest, digest);
+    blob->start_byte = start_byte;
+    blob->end_byte = end_byte;
+    index->count++;
+    return blob;
+}
+
+/**
+ * @brief Creates an empty blob index.
+ *
+ * @return A pointer to the newly created BlobIndex, or NULL on allocation failure.
+ */
+BlobIndex* blob_index_create() {
+    BlobIndex* index = (BlobIndex*)malloc(sizeof(BlobIndex));
+    if (index == NULL)
+        return index;
+    index->capacity = 64;
+    index->count = 0;
+    index->entries = calloc(index->capacity, sizeof(Blob));
+    if (index->entries == NULL) {
+        free(index);
+        return NULL;
+    }
+    return index;
+}
+
+/**
+ * @brief Loads the blob index from the blobs file.
+ *
+ * A missing blobs file is treated as an empty index, so repositories created
+ * before the blob store existed keep working.
+ *
+ * @return A pointer to the loaded BlobIndex, or NULL on allocation failure.
+ */
+BlobIndex* blob_index_load() {
+    BlobIndex* index = blob_index_create();
+    if (index == NULL)
+        return index;
+
+    FILE* blobs_file = fopen(BLOBS_FILE, "r");
+    if (blobs_file == NULL) {
+        return index;
+    }
+
+    // read lines
+    char digest[DIGEST_HEX_SIZE];
+    int64_t start_byte;
+    int64_t end_byte;
+    while (fscanf(blobs_file, "%64s %" SCNd64 " %" SCNd64, digest, &start_byte, &end_byte) == 3) {
+        blob_index_insert(index, digest, start_byte, end_byte);
+    }
+
+    fclose(blobs_file);
+    return index;
+}
+
+/**
+ * @brief Finds a blob by digest.
+ *
+ * @param index The blob index.
+ * @param digest The hexadecimal digest.
+ * @return A pointer to the blob, or NULL if it is not stored.
+ */
+Blob* blob_index_find(BlobIndex* index, const char* digest) {
+    size_t slot = blob_slot(index, digest);
+    while (index->entries[slot].digest[0] != '\0') {
+        if (strcmp(index->entries[slot].digest, digest) == 0) {
+            return &index->entries[slot];
+        }
+        slot = (slot + 1) & (index->capacity - 1);
+    }
+    return NULL;
+}
+
+/**
+ * @brief Encodes content as a delta against a base blob.
+ *
+ * The delta is only used if it is less than half the size of the content
+ * and the base is not already at the end of a DELTA_MAX_CHAIN long chain.
+ *
+ * @param payload The payload to fill.
+ * @param content The content to store.
+ * @param size The number of bytes in content.
+ * @param base The previous version of the content.
+ * @return 1 if the payload holds a delta, 0 if the content should be stored in full.
+ */
+static int blob_encode_delta(BlobPayload* payload, const char* content, size_t size, const Blob* base) {
+    int depth = contents_blob_depth(base->start_byte, base->end_byte);
+    if (depth < 0 || depth >= DELTA_MAX_CHAIN) {
+        return 0;
+    }
+
+    size_t base_size;
+    char* base_content = contents_read_blob(base->start_byte, base->end_byte, &base_size);
+    if (base_content == NULL) {
+        return 0;
+    }
+
+    // the payload starts with the base range
+    int64_t base_range[2] = { base->start_byte, base->end_byte };
+    size_t capacity = size / 2;
+    uint8_t* data = malloc(sizeof(base_range) + capacity);
+    size_t delta_size = 0;
+    if (data != NULL) {
+        memcpy(data, base_range, sizeof(base_range));
+        delta_size = delta_encode((const uint8_t*)base_content, base_size, (const uint8_t*)content, size, data + sizeof(base_range), capacity);
+    }
+    free(base_content);
+
+    if (delta_size == 0) {
+        free(data);
+        return 0;
+    }
+    payload->type = RECORD_DELTA;
+    payload->depth = (uint8_t)(depth + 1);
+    payload->data = data;
+    payload->owned = data;
+    payload->stored_size = sizeof(base_range) + delta_size;
+    return 1;
+}
+
+/**
+ * @brief Returns the compression level set in the config file.
+ *
+ * The level is read once per process, since large files store many chunks.
+ *
+ * @return The compression level, 0 if compression is disabled.
+ */
+static int blob_compression_level() {
+    static int level = -1;
+    if (level < 0) {
+        level = (int)config_get(CONFIG_COMPRESSION_LEVEL, COMPRESS_LEVEL_DEFAULT);
+    }
+    return level;
+}
+
+/**
+ * @brief Encodes content as the payload of a blob record.
+ *
+ * Content with a previous version is encoded as a delta when that pays off.
+ * Otherwise it is compressed at the level set in the config file and kept
+ * compressed only if that makes it smaller. Level 0 disables compression.
+ * A raw payload points at content, which must outlive it.
+ *
+ * @param payload The payload to fill, whose digest the caller sets.
+ * @param content The content to store.
+ * @param size The number of bytes in content.
+ * @param base The previous version of the content, or NULL if there is none.
+ */
+void blob_encode(BlobPayload* payload, const char* content, size_t size, const Blob* base) {
+    payload->type = RECORD_RAW;
+    payload->depth = 0;
+    payload->data = content;
+    payload->owned = NULL;
+    payload->stored_size = size;
+    payload->raw_size = (uint64_t)size;
+    if (base != NULL && blob_encode_delta(payload, content, size, base) == 1) {
+        return;
+    }
+
+    int level = blob_compression_level();
+    char* compressed = (level > 0 && size > 0) ? malloc(compress_bound(size)) : NULL;
+    if (compressed == NULL) {
+        return;
+    }
+    size_t compressed_size = compress_data(content, size, compressed, level);
+    if (compressed_size >= size) {
+        free(compressed);
+        return;
+    }
+    payload->type = RECORD_COMPRESSED;
+    payload->data = compressed;
+    payload->owned = compressed;
+    payload->stored_size = compressed_size;
+}
+
+/**
+ * @brief Releases the buffer an encoded payload owns.
+ *
+ * @param payload The payload.
+ */
+void blob_payload_free(BlobPayload* payload) {
+    free(payload->owned);
+    payload->owned = NULL;
+    payload->data = NULL;
+}
+
+/**
+ * @brief Records a new blob in the blobs file and the index.
+ *
+ * @param index The blob index.
+ * @param blobs_file The open blobs file, or NULL to open it for this blob only.
+ * @param digest The hexadecimal digest.
+ * @param start_byte The start of the blob in the contents file.
+ * @param end_byte The end of the blob in the contents file.
+ * @return A pointer to the stored entry, or NULL if it could not be recorded.
+ */
+static Blob* blob_record(BlobIndex* index, FILE* blobs_file, const char* digest, int64_t start_byte, int64_t end_byte) {
+    FILE* file = (blobs_file != NULL) ? blobs_file : open_file(BLOBS_FILE, "a");
+    if (file == NULL) {
+        return NULL;
+    }
+    fprintf(file, "%s %" PRId64 " %" PRId64 "\n", digest, start_byte, end_byte);
+    if (blobs_file == NULL) {
+        fclose(file);
+    }
+
+    return blob_index_insert(index, digest, start_byte, end_byte);
+}
+
+/**
+ * @brief Appends an encoded payload to the contents file unless its digest is already stored.
+ *
+ * @param index The blob index.
+ * @param blobs_file The open blobs file, or NULL to open it for this blob only.
+ * @param payload The encoded payload.
+ * @return A pointer to the new or existing blob, or NULL if it could not be written.
+ */
+Blob* blob_write(BlobIndex* index, FILE* blobs_file, const BlobPayload* payload) {
+    // identical content may have been written since the payload was encoded
+    Blob* blob = blob_index_find(index, payload->digest);
+    if (blob != NULL) {
+        return blob;
+    }
+
+    int64_t start_byte;
+    int64_t end_byte;
+    if (contents_append(payload->type, payload->depth, payload->data, payload->stored_size, payload->raw_size, &start_byte, &end_byte) == 0) {
+        return NULL;
+    }
+    return blob_record(index, blobs_file, payload->digest, start_byte, end_byte);
+}
+
+/**
+ * @brief Stores content in the blob store unless identical content is already there.
+ *
+ * @param index The blob index.
+ * @param content The content to store.
+ * @param size The number of bytes in content.
+ * @param base The previous version of the content to delta against, or NULL if there is none.
+ * @return A pointer to the new or existing blob, or NULL if it could not be written.
+ */
+Blob* blob_store(BlobIndex* index, const char* content, size_t size, const Blob* base) {
+    BlobPayload payload;
+    sha256_hex(content, size, payload.digest);
+
+    // reuse identical content
+    Blob* blob = blob_index_find(index, payload.digest);
+    if (blob != NULL) {
+        return blob;
+    }
+
+    // append to contents file as a delta or a full copy
+    blob_encode(&payload, content, size, base);
+    blob = blob_write(index, NULL, &payload);
+    blob_payload_free(&payload);
+    return blob;
+}
+
+/**
+ * @brief Readies the blob store for threads that encode while one thread writes.
+ *
+ * Everything encoding reads lazily is read here instead: the compression
+ * level, and the mapping of the contents file, which then covers every base
+ * blob an encoding thread may read while the writer appends.
+ *
+ * @return 1 on success, 0 otherwise.
+ */
+int blob_store_prepare() {
+    blob_compression_level();
+    return contents_prepare();
+}
+
+/**
+ * @brief Streams a large file into the blob store as a list of chunks.
+ *
+ * The file is read through a window of two maximum-size chunks. Each
+ * content-defined chunk is hashed into the file digest and stored as a blob
+ * of its own, so chunks that did not change since an earlier version are found
+ * by digest and not written again. Memory use does not depend on the file size,
+ * apart from the list of chunk ranges.
+ *
+ * @param index The blob index.
+ * @param file The open file, positioned at its start.
+ * @return A pointer to the new or existing blob, or NULL if it could not be written.
+ */
+static Blob* blob_store_chunks(BlobIndex* index, FILE* file) {
+    size_t window_size = 2 * CHUNK_MAX_SIZE;
+    uint8_t* window = malloc(window_size);
+    if (window == NULL) {
+        return NULL;
+    }
+
+    Sha256Context context;
+    sha256_init(&context);
+    int64_t* ranges = NULL;
+    size_t count = 0;
+    size_t capacity = 0;
+    uint64_t total = 0;
+
+    size_t position = 0;
+    size_t filled = 0;
+    int eof = 0;
+    int ok = 1;
+    while (ok) {
+        // keep a whole maximum-size chunk ahead, so cut points do not depend on reads
+        if (eof == 0 && filled - position < CHUNK_MAX_SIZE) {
+            memmove(window, window + position, filled - position);
+            filled -= position;
+            position = 0;
+            while (eof == 0 && filled < window_size) {
+                size_t bytes_read = fread(window + filled, 1, window_size - filled, file);
+                if (bytes_read == 0) {
+                    eof = 1;
+                }
+                filled += bytes_read;
+            }
+        }
+        if (position == filled) {
+            break;
+        }
+
+        size_t length = chunk_next(window + position, filled - position);
+        sha256_update(&context, window + position, length);
+
+        if (count == capacity) {
+            capacity = (capacity == 0) ? 64 : capacity * 2;
+            int64_t* grown = realloc(ranges, capacity * 2 * sizeof(int64_t));
+            if (grown == NULL) {
+                ok = 0;
+                break;
+            }
+            ranges = grown;
+        }
+
+        Blob* chunk = blob_store(index, (const char*)window + position, length, NULL);
+        if (chunk == NULL) {
+            ok = 0;
+            break;
+        }
+        ranges[2 * count] = chunk->start_byte;
+        ranges[2 * count + 1] = chunk->end_byte;
+        count++;
+        total += length;
+        position += length;
+    }
+    free(window);
+    if (ferror(file)) {
+        ok = 0;
+    }
+
+    Blob* blob = NULL;
+    if (ok) {
+        uint8_t raw_digest[DIGEST_SIZE];
+        char digest[DIGEST_HEX_SIZE];
+        sha256_final(&context, raw_digest);
+        digest_to_hex(raw_digest, digest);
+
+        // identical content already has its chunks and its chunk list
+        blob = blob_index_find(index, digest);
+        int64_t start_byte;
+        int64_t end_byte;
+        if (blob == NULL && contents_append(RECORD_CHUNKED, 0, ranges, count * 2 * sizeof(int64_t), total, &start_byte, &end_byte) == 1) {
+            blob = blob_record(index, NULL, digest, start_byte, end_byte);
+        }
+    }
+    free(ranges);
+    return blob;
+}
+
+/**
+ * @brief Stores the contents of a file in the blob store.
+ *
+ * Files below CHUNK_THRESHOLD are read whole and stored with blob_store.
+ * Larger files are streamed in chunks, so they are never held in memory.
+ *
+ * @param index The blob index.
+ * @param path The path of the file.
+ * @param base The previous version of the file to delta against, or NULL if there is none.
+ * @return A pointer to the new or existing blob, or NULL if it could not be read or written.
+ */
+Blob* blob_store_file(BlobIndex* index, const char* path, const Blob* base) {
+    FILE* file = open_file(path, "rb");
+    if (file == NULL) {
+        return NULL;
+    }
+
+    // get file size
+    fseeko(file, 0, SEEK_END);
+    off_t file_size = ftello(file);
+    rewind(file);
+
+    if (file_size >= CHUNK_THRESHOLD) {
+        Blob* blob = blob_store_chunks(index, file);
+        fclose(file);
+        return blob;
+    }
+
+    char* content = malloc((size_t)file_size + 1);
+    if (content == NULL) {
+        fclose(file);
+        return NULL;
+    }
+    size_t bytes_read = fread(content, 1, (size_t)file_size, file);
+    fclose(file);
+
+    Blob* blob = blob_store(index, content, bytes_read, base);
+    free(content);
+    return blob;
+}
+
+/**
+ * @brief Destroys the blob index and frees the memory.
+ *
+ * @param index The blob index.
+ */
+void blob_index_destroy(BlobIndex* index) {
+    free(index->entries);
+    free(index);
+}
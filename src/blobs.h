@@ -0,0 +1,53 @@
+# ifndef __BLOBS_H__
+# define __BLOBS_H__
+
+# include <stdio.h>
+# include <stddef.h>
+# include <stdint.h>
+
+# include "sha256.h"
+
+typedef struct blob Blob;
+typedef struct blob_index BlobIndex;
+typedef struct blob_payload BlobPayload;
+
+struct blob {
+    char digest[DIGEST_HEX_SIZE];
+    int64_t start_byte;
+    int64_t end_byte;
+};
+
+struct blob_index {
+    Blob* entries;
+    size_t capacity;
+    size_t count;
+};
+
+/**
+ * Content encoded as the payload of a blob record, ready to be appended.
+ * Data points either at the content itself or at the buffer in owned.
+ */
+struct blob_payload {
+    char digest[DIGEST_HEX_SIZE];
+    uint8_t type;
+    uint8_t depth;
+    const void* data;
+    void* owned;
+    size_t stored_size;
+    uint64_t raw_size;
+};
+
+// function prototypes
+BlobIndex* blob_index_create();
+BlobIndex* blob_index_load();
+Blob* blob_index_insert(BlobIndex* index, const char* digest, int64_t start_byte, int64_t end_byte);
+Blob* blob_index_find(BlobIndex* index, const char* digest);
+void blob_encode(BlobPayload* payload, const char* content, size_t size, const Blob* base);
+void blob_payload_free(BlobPayload* payload);
+Blob* blob_write(BlobIndex* index, FILE* blobs_file, const BlobPayload* payload);
+Blob* blob_store(BlobIndex* index, const char* content, size_t size, const Blob* base);
+int blob_store_prepare();
+Blob* blob_store_file(BlobIndex* index, const char* path, const Blob* base);
+void blob_index_destroy(BlobIndex* index);
+
+# endif
@@ -0,0 +1,380 @@
+/**
+ * @file cache.c
+ * @brief Stat cache for the VCS (Version Control System).
+ *
+ * The stat cache remembers, for every path that was committed, the stat data
+ * of the file when its content was stored and the digest of that content. At
+ * commit time a staged file whose modification time, change time, size and
+ * inode all match its entry reuses the stored blob without being read, so a
+ * commit of a large tree with a few edits costs one stat per unchanged file.
+ *
+ * The cache file holds a 24-byte header with the magic, the format version,
+ * the time the cache was written and the number of entries, followed by the
+ * entries, each one followed by its NUL-terminated path. A missing or
+ * malformed cache is treated as empty.
+ */
+# include <stdio.h>
+# include <stdlib.h>
+# include <string.h>
+# include <time.h>
+
+# include "validations.h"
+# include "files.h"
+# include "cache.h"
+
+/// Settings
+# define CACHE_MIN_CAPACITY 16
+
+// nanosecond timestamps are named differently on macOS
+# ifdef __APPLE__
+# define STAT_MTIME_NSEC(st) ((st)->st_mtimespec.tv_nsec)
+# define STAT_CTIME_NSEC(st) ((st)->st_ctimespec.tv_nsec)
+# else
+# define STAT_MTIME_NSEC(st) ((st)->st_mtim.tv_nsec)
+# define STAT_CTIME_NSEC(st) ((st)->st_ctim.tv_nsec)
+# endif
+
+/**
+ * @brief Hashes a path with 64-bit FNV-1a.
+ *
+ * @param path The path.
+ * @return The hash.
+ */
+static uint64_t cache_hash(const char* path) {
+    uint64_t hash = 14695981039346656037ULL;
+    for (const unsigned char* c = (const unsigned char*)path; *c != '\0'; c++) {
+        hash ^= *c;
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+/**
+ * @brief Finds the slot of a path, or the empty slot where it would go.
+ *
+ * @param cache The stat cache.
+ * @param path The path.
+ * @return The slot position.
+ */
+static size_t cache_slot(const StatCache* cache, const char* path) {
+    size_t mask = cache->slot_count - 1;
+    for (size_t i = (size_t)cache_hash(path) & mask;; i = (i + 1) & mask) {
+        uint32_t slot = cache->slots[i];
+        if (slot == 0 || strcmp(cache->paths[slot - 1], path) == 0) {
+            return i;
+        }
+    }
+}
+
+/**
+ * @brief Allocates from the arena of the cache, terminating the program on failure.
+ *
+ * @param cache The stat cache.
+ * @param size The number of bytes to allocate.
+ * @return The allocation.
+ */
+static void* cache_alloc(StatCache* cache, size_t size) {
+    void* pointer = arena_alloc(cache->arena, size);
+    if (pointer == NULL) {
+        printf("vcs: error: could not allocate memory for stat cache\n");
+        exit(EXIT_FAILURE);
+    }
+    return pointer;
+}
+
+/**
+ * @brief Makes room for at least the given number of entries.
+ *
+ * @param cache The stat cache.
+ * @param capacity The number of entries to make room for.
+ */
+static void cache_reserve(StatCache* cache, size_t capacity) {
+    if (capacity <= cache->capacity) {
+        return;
+    }
+
+    char** paths = (char**)cache_alloc(cache, capacity * sizeof(char*));
+    StatCacheEntry* entries = (StatCacheEntry*)cache_alloc(cache, capacity * sizeof(StatCacheEntry));
+    if (cache->count > 0) {
+        memcpy(paths, cache->paths, cache->count * sizeof(char*));
+        memcpy(entries, cache->entries, cache->count * sizeof(StatCacheEntry));
+    }
+    cache->paths = paths;
+    cache->entries = entries;
+    cache->capacity = capacity;
+
+    size_t slot_count = CACHE_MIN_CAPACITY;
+    while (slot_count < capacity * 2) {
+        slot_count *= 2;
+    }
+    if (slot_count > cache->slot_count) {
+        cache->slots = (uint32_t*)cache_alloc(cache, slot_count * sizeof(uint32_t));
+        memset(cache->slots, 0, slot_count * sizeof(uint32_t));
+        cache->slot_count = slot_count;
+        for (size_t i = 0; i < cache->count; i++) {
+            cache->slots[cache_slot(cache, cache->paths[i])] = (uint32_t)(i + 1);
+        }
+    }
+}
+
+/**
+ * @brief Returns the entry of a path, adding an empty one if the path has none.
+ *
+ * @param cache The stat cache.
+ * @param path The path.
+ * @param copy 1 to copy the path into the arena, 0 if it already lives there.
+ * @return The entry.
+ */
+static StatCacheEntry* cache_entry(StatCache* cache, char* path, int copy) {
+    if (cache->count == cache->capacity) {
+        cache_reserve(cache, cache->capacity * 2);
+    }
+
+    size_t i = cache_slot(cache, path);
+    if (cache->slots[i] != 0) {
+        return &cache->entries[cache->slots[i] - 1];
+    }
+    if (copy) {
+        path = arena_strdup(cache->arena, path);
+        if (path == NULL) {
+            printf("vcs: error: could not allocate memory for stat cache\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+    cache->paths[cache->count] = path;
+    memset(&cache->entries[cache->count], 0, sizeof(StatCacheEntry));
+    cache->slots[i] = (uint32_t)(++cache->count);
+    return &cache->entries[cache->count - 1];
+}
+
+/**
+ * @brief Reads the entries of the cache file into the cache.
+ *
+ * The paths are used in place in the buffer the file is read into.
+ *
+ * @param cache The empty stat cache to fill.
+ * @return 1 if the file was read successfully, 0 otherwise.
+ */
+static int cache_read(StatCache* cache) {
+    FILE* file = open_file(CACHE_FILE, "rb");
+    if (file == NULL) {
+        return 0;
+    }
+    fseeko(file, 0, SEEK_END);
+    size_t size = (size_t)ftello(file);
+    rewind(file);
+
+    // terminate the buffer, so a truncated cache cannot run past it
+    char* data = (char*)cache_alloc(cache, size + 1);
+    size_t bytes_read = fread(data, 1, size, file);
+    fclose(file);
+    data[bytes_read] = '\0';
+
+    uint32_t version = 0;
+    uint64_t count = 0;
+    if (bytes_read >= CACHE_HEADER_SIZE) {
+        memcpy(&version, data + 4, sizeof(version));
+        memcpy(&cache->written_at, data + 8, sizeof(cache->written_at));
+        memcpy(&count, data + 16, sizeof(count));
+    }
+    if (bytes_read < CACHE_HEADER_SIZE || memcmp(data, CACHE_MAGIC, 4) != 0 || version != CACHE_VERSION) {
+        return 0;
+    }
+
+    cache_reserve(cache, (size_t)count);
+    char* cursor = data + CACHE_HEADER_SIZE;
+    char* end = data + bytes_read;
+    for (uint64_t i = 0; i < count; i++) {
+        char* path = cursor + sizeof(StatCacheEntry);
+        char* terminator = (path < end) ? memchr(path, '\0', (size_t)(end - path)) : NULL;
+        if (terminator == NULL) {
+            return 0;
+        }
+        memcpy(cache_entry(cache, path, 0), cursor, sizeof(StatCacheEntry));
+        cursor = terminator + 1;
+    }
+    return 1;
+}
+
+/**
+ * @brief Loads the stat cache into the arena.
+ *
+ * @param arena The arena that holds the cache.
+ * @return A pointer to the loaded StatCache, or NULL on allocation failure.
+ */
+StatCache* stat_cache_load(Arena* arena) {
+    StatCache* cache = (StatCache*)arena_alloc(arena, sizeof(StatCache));
+    if (cache == NULL)
+        return cache;
+    cache->count = 0;
+    cache->capacity = 0;
+    cache->paths = NULL;
+    cache->entries = NULL;
+    cache->slots = NULL;
+    cache->slot_count = 0;
+    cache->written_at = 0;
+    cache->arena = arena;
+    cache_reserve(cache, CACHE_MIN_CAPACITY);
+
+    // a missing or malformed cache only means files are read again
+    if (file_exists(CACHE_FILE) == 1 && cache_read(cache) == 0) {
+        printf("vcs: warning: ignoring malformed %s\n", CACHE_FILE);
+        cache->count = 0;
+        cache->written_at = 0;
+        memset(cache->slots, 0, cache->slot_count * sizeof(uint32_t));
+    }
+
+    // entries that were racy when the cache was written stay untrusted once it is written again, unless they are updated
+    for (size_t i = 0; i < cache->count; i++) {
+        StatCacheEntry* entry = &cache->entries[i];
+        if (entry->mtime_seconds >= cache->written_at) {
+            memset(entry, 0, offsetof(StatCacheEntry, digest));
+        }
+    }
+    return cache;
+}
+
+/**
+ * @brief Finds the digest of a file whose stat data has not changed since it was stored.
+ *
+ * @param cache The stat cache.
+ * @param path The path of the file.
+ * @param st The current stat data of the file.
+ * @return The digest of the stored content, or NULL if the file must be read.
+ */
+const uint8_t* stat_cache_lookup(const StatCache* cache, const char* path, const struct stat* st) {
+    uint32_t slot = cache->slots[cache_slot(cache, path)];
+    if (slot == 0) {
+        return NULL;
+    }
+    const StatCacheEntry* entry = &cache->entries[slot - 1];
+
+    // a file modified in the second the cache was written may have changed since
+    if (entry->mtime_seconds >= cache->written_at) {
+        return NULL;
+    }
+    if (entry->mtime_seconds != (int64_t)st->st_mtime || entry->mtime_nanoseconds != (int64_t)STAT_MTIME_NSEC(st)) {
+        return NULL;
+    }
+    if (entry->ctime_seconds != (int64_t)st->st_ctime || entry->ctime_nanoseconds != (int64_t)STAT_CTIME_NSEC(st)) {
+        return NULL;
+    }
+    if (entry->size != (uint64_t)st->st_size || entry->inode != (uint64_t)st->st_ino) {
+        return NULL;
+    }
+    return entry->digest;
+}
+
+/**
+ * @brief Finds the digest a file had when its entry was last recorded, whatever its stat data is now.
+ *
+ * Only callers that know the file has not changed since then, such as a
+ * status told so by the monitor, may trust the result.
+ *
+ * @param cache The stat cache.
+ * @param path The path of the file.
+ * @return The digest of the recorded content, or NULL if the path has no entry.
+ */
+const uint8_t* stat_cache_digest(const StatCache* cache, const char* path) {
+    uint32_t slot = cache->slots[cache_slot(cache, path)];
+    return (slot == 0) ? NULL : cache->entries[slot - 1].digest;
+}
+
+/**
+ * @brief Records the stat data and stored digest of a file.
+ *
+ * @param cache The stat cache.
+ * @param path The path of the file.
+ * @param st The stat data of the file, taken before its content was read.
+ * @param digest The digest of the stored content.
+ */
+void stat_cache_update(StatCache* cache, const char* path, const struct stat* st, const uint8_t digest[DIGEST_SIZE]) {
+    StatCacheEntry* entry = cache_entry(cache, (char*)path, 1);
+    entry->mtime_seconds = (int64_t)st->st_mtime;
+    entry->mtime_nanoseconds = (int64_t)STAT_MTIME_NSEC(st);
+    entry->ctime_seconds = (int64_t)st->st_ctime;
+    entry->ctime_nanoseconds = (int64_t)STAT_CTIME_NSEC(st);
+    entry->size = (uint64_t)st->st_size;
+    entry->inode = (uint64_t)st->st_ino;
+    memcpy(entry->digest, digest, DIGEST_SIZE);
+}
+
+/**
+ * @brief Forgets the entry of a file that no longer exists.
+ *
+ * The last entry moves into the freed position, and the slots after the
+ * freed slot shift back so that no probe sequence is broken.
+ *
+ * @param cache The stat cache.
+ * @param path The path of the file.
+ * @return 1 if the path had an entry, 0 otherwise.
+ */
+int stat_cache_remove(StatCache* cache, const char* path) {
+    size_t mask = cache->slot_count - 1;
+    size_t hole = cache_slot(cache, path);
+    if (cache->slots[hole] == 0) {
+        return 0;
+    }
+    size_t index = cache->slots[hole] - 1;
+
+    cache->slots[hole] = 0;
+    for (size_t i = (hole + 1) & mask; cache->slots[i] != 0; i = (i + 1) & mask) {
+        size_t home = (size_t)cache_hash(cache->paths[cache->slots[i] - 1]) & mask;
+        // the slot may fill the hole unless its home lies after the hole, up to the slot
+        if (((i - home) & mask) >= ((i - hole) & mask)) {
+            cache->slots[hole] = cache->slots[i];
+            cache->slots[i] = 0;
+            hole = i;
+        }
+    }
+
+    size_t last = cache->count - 1;
+    if (index != last) {
+        cache->paths[index] = cache->paths[last];
+        cache->entries[index] = cache->entries[last];
+        cache->slots[cache_slot(cache, cache->paths[index])] = (uint32_t)(index + 1);
+    }
+    cache->count--;
+    return 1;
+}
+
+/**
+ * @brief Writes the stat cache back to the cache file.
+ *
+ * The cache is written to a temporary file of its own and renamed into
+ * place, so an interrupted write leaves the previous cache untouched, and
+ * commands saving the cache at the same time do not write the same file.
+ *
+ * @param cache The stat cache.
+ * @return 1 if the cache was written successfully, 0 otherwise.
+ */
+int stat_cache_save(const StatCache* cache) {
+    char temporary[64];
+    FILE* file = open_temporary(CACHE_FILE, temporary, sizeof(temporary));
+    if (file == NULL) {
+        return 0;
+    }
+
+    uint32_t version = CACHE_VERSION;
+    int64_t written_at = (int64_t)time(NULL);
+    uint64_t count = (uint64_t)cache->count;
+    int ok = (fwrite(CACHE_MAGIC, 1, 4, file) == 4);
+    ok = ok && (fwrite(&version, sizeof(version), 1, file) == 1);
+    ok = ok && (fwrite(&written_at, sizeof(written_at), 1, file) == 1);
+    ok = ok && (fwrite(&count, sizeof(count), 1, file) == 1);
+    for (size_t i = 0; ok && i < cache->count; i++) {
+        size_t length = strlen(cache->paths[i]) + 1;
+        ok = (fwrite(&cache->entries[i], sizeof(StatCacheEntry), 1, file) == 1);
+        ok = ok && (fwrite(cache->paths[i], 1, length, file) == length);
+    }
+
+    if (fclose(file) != 0) {
+        ok = 0;
+    }
+    if (ok && rename(temporary, CACHE_FILE) == 0) {
+        return 1;
+    }
+    remove(temporary);
+    printf("vcs: error: could not write %s file\n", CACHE_FILE);
+    return 0;
+}
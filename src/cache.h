@@ -0,0 +1,59 @@
+# ifndef __CACHE_H__
+# define __CACHE_H__
+
+# include <stddef.h>
+# include <stdint.h>
+# include <sys/stat.h>
+
+# include "arena.h"
+# include "sha256.h"
+
+/// Format
+# define CACHE_MAGIC "VCSC"
+# define CACHE_VERSION 1
+# define CACHE_HEADER_SIZE 24
+
+typedef struct stat_cache_entry StatCacheEntry;
+typedef struct stat_cache StatCache;
+
+/**
+ * Stat data of a file when its content was last stored, and the digest of
+ * that content. On disk each entry is followed by its NUL-terminated path.
+ */
+struct stat_cache_entry {
+    int64_t mtime_seconds;
+    int64_t mtime_nanoseconds;
+    int64_t ctime_seconds;
+    int64_t ctime_nanoseconds;
+    uint64_t size;
+    uint64_t inode;
+    uint8_t digest[DIGEST_SIZE];
+};
+
+/**
+ * Cache entries by path, with an open-addressing hash set over the paths
+ * like the stage. Entries written in the same second as the cache itself
+ * are not trusted, since the file could still change within that second
+ * without changing its stat data. Their stat data is cleared when the cache
+ * is loaded, so they are not trusted after the next write either.
+ */
+struct stat_cache {
+    size_t count;
+    size_t capacity;
+    char** paths;
+    StatCacheEntry* entries;
+    uint32_t* slots;
+    size_t slot_count;
+    int64_t written_at;
+    Arena* arena;
+};
+
+// function prototypes
+StatCache* stat_cache_load(Arena* arena);
+const uint8_t* stat_cache_lookup(const StatCache* cache, const char* path, const struct stat* st);
+const uint8_t* stat_cache_digest(const StatCache* cache, const char* path);
+void stat_cache_update(StatCache* cache, const char* path, const struct stat* st, const uint8_t digest[DIGEST_SIZE]);
+int stat_cache_remove(StatCache* cache, const char* path);
+int stat_cache_save(const StatCache* cache);
+
+# endif
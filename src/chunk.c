@@ -0,0 +1,75 @@
+/**
+ * @file chunk.c
+ * @brief Content-defined chunking of large files for the VCS (Version Control System).
+ *
+ * Large files are cut into chunks with FastCDC: a gear hash rolls over the
+ * data and a chunk ends where its top bits are zero. Cut points depend only on
+ * the nearby bytes, so an edit moves the boundaries of the chunks around it
+ * and leaves the others, and their digests, unchanged.
+ *
+ * Normalized chunking uses a stricter mask before CHUNK_AVG_SIZE and a looser
+ * one after it, which keeps chunk sizes close to the average.
+ */
+# include "chunk.h"
+
+// 18 and 14 top bits, around the 16 bits of a 64 KiB average
+# define CHUNK_MASK_SMALL 0xffffc00000000000ULL
+# define CHUNK_MASK_LARGE 0xfffc000000000000ULL
+
+static uint64_t gear[256];
+static int gear_ready = 0;
+
+/**
+ * @brief Fills the gear table with fixed pseudo-random values.
+ *
+ * The values must never change, or chunks of existing files would no longer
+ * match the chunks of new versions.
+ */
+static void chunk_init_gear() {
+    uint64_t state = 0x5643532d43444321ULL;
+    for (int i = 0; i < 256; i++) {
+        // splitmix64
+        state += 0x9e3779b97f4a7c15ULL;
+        uint64_t value = state;
+        value = (value ^ (value >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        value = (value ^ (value >> 27)) * 0x94d049bb133111ebULL;
+        gear[i] = value ^ (value >> 31);
+    }
+    gear_ready = 1;
+}
+
+/**
+ * @brief Finds the end of the next chunk.
+ *
+ * @param data The remaining data.
+ * @param size The number of bytes in data.
+ * @return The length of the next chunk.
+ */
+size_t chunk_next(const uint8_t* data, size_t size) {
+    if (gear_ready == 0) {
+        chunk_init_gear();
+    }
+    if (size <= CHUNK_MIN_SIZE) {
+        return size;
+    }
+
+    size_t limit = (size < CHUNK_MAX_SIZE) ? size : CHUNK_MAX_SIZE;
+    size_t normal = (limit < CHUNK_AVG_SIZE) ? limit : CHUNK_AVG_SIZE;
+    uint64_t hash = 0;
+
+    // bytes below the minimum size never end a chunk
+    size_t i = CHUNK_MIN_SIZE;
+    for (; i < normal; i++) {
+        hash = (hash << 1) + gear[data[i]];
+        if ((hash & CHUNK_MASK_SMALL) == 0) {
+            return i + 1;
+        }
+    }
+    for (; i < limit; i++) {
+        hash = (hash << 1) + gear[data[i]];
+        if ((hash & CHUNK_MASK_LARGE) == 0) {
+            return i + 1;
+        }
+    }
+    return limit;
+}
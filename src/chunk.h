@@ -0,0 +1,16 @@
+# ifndef __CHUNK_H__
+# define __CHUNK_H__
+
+# include <stddef.h>
+# include <stdint.h>
+
+/// Settings
+# define CHUNK_THRESHOLD (1024 * 1024)
+# define CHUNK_MIN_SIZE (16 * 1024)
+# define CHUNK_AVG_SIZE (64 * 1024)
+# define CHUNK_MAX_SIZE (256 * 1024)
+
+// function prototypes
+size_t chunk_next(const uint8_t* data, size_t size);
+
+# endif
@@ -0,0 +1,229 @@
+/**
+ * @file commit_index.c
+ * @brief Sorted commit identifier index for the VCS (Version Control System).
+ *
+ * The commit index maps commit identifiers to their slot in the metadata
+ * index. Entries are sorted by identifier behind a 256-entry fanout table, so
+ * a lookup is a binary search over a mapped file and does not parse history.
+ *
+ * The index covers the first "covered" metadata records. Newer records form a
+ * short unsorted tail that lookups scan directly; the index is rebuilt at
+ * commit time once the tail reaches COMMIT_INDEX_MAX_TAIL records.
+ */
+# include <stdio.h>
+# include <stdlib.h>
+# include <string.h>
+# include <fcntl.h>
+# include <unistd.h>
+# include <sys/mman.h>
+# include <sys/stat.h>
+
+# include "validations.h"
+# include "files.h"
+# include "commit_index.h"
+
+/**
+ * @brief Maps the commit index into memory for reading.
+ *
+ * A missing or malformed index is returned empty, so every metadata record is
+ * then treated as part of the unsorted tail.
+ *
+ * @return A pointer to the opened CommitIndex, or NULL on allocation failure.
+ */
+CommitIndex* commit_index_open() {
+    CommitIndex* index = (CommitIndex*)malloc(sizeof(CommitIndex));
+    if (index == NULL)
+        return index;
+    index->map = NULL;
+    index->map_size = 0;
+    index->fanout = NULL;
+    index->entries = NULL;
+    index->count = 0;
+    index->covered = 0;
+
+    int fd = open(COMMIT_INDEX_FILE, O_RDONLY);
+    if (fd < 0) {
+        return index;
+    }
+
+    struct stat st;
+    size_t table_size = COMMIT_INDEX_HEADER_SIZE + COMMIT_INDEX_FANOUT * sizeof(uint32_t);
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < table_size) {
+        close(fd);
+        return index;
+    }
+
+    void* map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        return index;
+    }
+
+    const uint32_t* header = (const uint32_t*)map;
+    if (memcmp(map, COMMIT_INDEX_MAGIC, 4) != 0 || header[1] != COMMIT_INDEX_VERSION) {
+        munmap(map, (size_t)st.st_size);
+        return index;
+    }
+
+    index->map = map;
+    index->map_size = (size_t)st.st_size;
+    index->covered = header[2];
+    index->fanout = header + COMMIT_INDEX_HEADER_SIZE / sizeof(uint32_t);
+    index->entries = (const CommitIndexEntry*)((const char*)map + table_size);
+    index->count = (index->map_size - table_size) / sizeof(CommitIndexEntry);
+    return index;
+}
+
+/**
+ * @brief Unmaps the commit index and frees the memory.
+ *
+ * @param index The commit index.
+ */
+void commit_index_close(CommitIndex* index) {
+    if (index->map != NULL) {
+        munmap(index->map, index->map_size);
+    }
+    free(index);
+}
+
+/**
+ * @brief Compares an identifier with a hexadecimal prefix.
+ *
+ * @param id The identifier.
+ * @param prefix The prefix as a digest, zero-padded after the last nibble.
+ * @param nibbles The number of hexadecimal digits in the prefix.
+ * @return A negative value, zero, or a positive value as the identifier sorts before, within, or after the prefix range.
+ */
+static int prefix_compare(const uint8_t* id, const uint8_t* prefix, size_t nibbles) {
+    int cmp = memcmp(id, prefix, nibbles / 2);
+    if (cmp != 0 || nibbles % 2 == 0) {
+        return cmp;
+    }
+    return (int)(id[nibbles / 2] & 0xf0) - (int)prefix[nibbles / 2];
+}
+
+/**
+ * @brief Resolves an abbreviated commit hash to metadata slots.
+ *
+ * Matches in the sorted index are found with a lower-bound binary search
+ * followed by a scan of at most two entries; the unsorted tail is scanned
+ * directly. Resolution stops at the second match, which is enough to report
+ * an ambiguous prefix.
+ *
+ * @param index The commit index.
+ * @param metadata The metadata index.
+ * @param prefix The hexadecimal prefix, COMMIT_PREFIX_MIN to 64 characters.
+ * @param slots Receives the slots of up to two matching commits.
+ * @return The number of matches found, at most 2; 0 if the prefix is invalid or matches nothing.
+ */
+size_t commit_index_resolve(CommitIndex* index, MetadataIndex* metadata, const char* prefix, long slots[2]) {
+    size_t nibbles = strlen(prefix);
+    uint8_t id[DIGEST_SIZE];
+    if (nibbles < COMMIT_PREFIX_MIN || hex_to_digest(prefix, id) == 0) {
+        return 0;
+    }
+
+    // an index covering more commits than exist is stale
+    size_t covered = index->covered;
+    if (covered > metadata->count || index->count != covered) {
+        covered = 0;
+    }
+
+    size_t found = 0;
+    if (covered > 0) {
+        // lower bound within the fanout bucket of the first byte
+        size_t low = (id[0] == 0) ? 0 : index->fanout[id[0] - 1];
+        size_t high = index->fanout[id[0]];
+        while (low < high) {
+            size_t middle = low + (high - low) / 2;
+            if (prefix_compare(index->entries[middle].id, id, nibbles) < 0) {
+                low = middle + 1;
+            } else {
+                high = middle;
+            }
+        }
+
+        // matching entries are contiguous from the lower bound
+        while (low < covered && found < 2 && prefix_compare(index->entries[low].id, id, nibbles) == 0) {
+            slots[found++] = (long)index->entries[low].slot;
+            low++;
+        }
+    }
+
+    // scan records committed after the index was built
+    for (size_t i = covered; i < metadata->count && found < 2; i++) {
+        if (prefix_compare(metadata->records[i].id, id, nibbles) == 0) {
+            slots[found++] = (long)i;
+        }
+    }
+    return found;
+}
+
+/**
+ * @brief Orders index entries by identifier.
+ */
+static int compare_entries(const void* a, const void* b) {
+    return memcmp(((const CommitIndexEntry*)a)->id, ((const CommitIndexEntry*)b)->id, DIGEST_SIZE);
+}
+
+/**
+ * @brief Rebuilds the commit index if too many commits are outside it.
+ *
+ * @param metadata The metadata index, including the newest commit.
+ * @return 1 if the index is up to date or was rebuilt, 0 if it could not be written.
+ */
+int commit_index_update(MetadataIndex* metadata) {
+    CommitIndex* index = commit_index_open();
+    if (index == NULL) {
+        return 0;
+    }
+    int current = (index->covered <= metadata->count && index->count == index->covered
+                   && metadata->count - index->covered < COMMIT_INDEX_MAX_TAIL);
+    commit_index_close(index);
+    if (current) {
+        return 1;
+    }
+
+    // collect and sort every commit
+    CommitIndexEntry* entries = malloc((metadata->count + 1) * sizeof(CommitIndexEntry));
+    if (entries == NULL) {
+        return 0;
+    }
+    for (size_t i = 0; i < metadata->count; i++) {
+        memcpy(entries[i].id, metadata->records[i].id, DIGEST_SIZE);
+        entries[i].slot = (uint32_t)i;
+    }
+    qsort(entries, metadata->count, sizeof(CommitIndexEntry), compare_entries);
+
+    // fanout[b] counts entries whose first byte is at most b
+    uint32_t fanout[COMMIT_INDEX_FANOUT];
+    memset(fanout, 0, sizeof(fanout));
+    for (size_t i = 0; i < metadata->count; i++) {
+        fanout[entries[i].id[0]]++;
+    }
+    for (int b = 1; b < COMMIT_INDEX_FANOUT; b++) {
+        fanout[b] += fanout[b - 1];
+    }
+
+    // write to a temporary file and rename into place
+    FILE* file = open_file(COMMIT_INDEX_FILE ".tmp", "wb");
+    if (file == NULL) {
+        free(entries);
+        return 0;
+    }
+    uint32_t header[4] = { 0, COMMIT_INDEX_VERSION, (uint32_t)metadata->count, 0 };
+    memcpy(header, COMMIT_INDEX_MAGIC, 4);
+    int ok = (fwrite(header, sizeof(header), 1, file) == 1);
+    ok = ok && (fwrite(fanout, sizeof(fanout), 1, file) == 1);
+    ok = ok && (fwrite(entries, sizeof(CommitIndexEntry), metadata->count, file) == metadata->count);
+    if (fclose(file) != 0) {
+        ok = 0;
+    }
+    free(entries);
+
+    if (ok && rename(COMMIT_INDEX_FILE ".tmp", COMMIT_INDEX_FILE) == 0) {
+        return 1;
+    }
+    remove(COMMIT_INDEX_FILE ".tmp");
+    return 0;
+}
@@ -0,0 +1,45 @@
+# ifndef __COMMIT_INDEX_H__
+# define __COMMIT_INDEX_H__
+
+# include <stddef.h>
+# include <stdint.h>
+
+# include "sha256.h"
+# include "metadata.h"
+
+/// Format
+# define COMMIT_INDEX_MAGIC "VCSI"
+# define COMMIT_INDEX_VERSION 1
+# define COMMIT_INDEX_HEADER_SIZE 16
+# define COMMIT_INDEX_FANOUT 256
+# define COMMIT_INDEX_MAX_TAIL 256
+# define COMMIT_PREFIX_MIN 4
+
+typedef struct commit_index_entry CommitIndexEntry;
+typedef struct commit_index CommitIndex;
+
+/**
+ * One entry per indexed commit, sorted by identifier. The slot is the
+ * position of the commit record in the metadata index.
+ */
+struct commit_index_entry {
+    uint8_t id[DIGEST_SIZE];
+    uint32_t slot;
+};
+
+struct commit_index {
+    void* map;
+    size_t map_size;
+    const uint32_t* fanout;
+    const CommitIndexEntry* entries;
+    size_t count;
+    uint32_t covered;
+};
+
+// function prototypes
+CommitIndex* commit_index_open();
+void commit_index_close(CommitIndex* index);
+size_t commit_index_resolve(CommitIndex* index, MetadataIndex* metadata, const char* prefix, long slots[2]);
+int commit_index_update(MetadataIndex* metadata);
+
+# endif
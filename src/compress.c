@@ -0,0 +1,400 @@
+/**
+ * @file compress.c
+ * @brief Blob compression for the VCS (Version Control System).
+ *
+ * Blobs are compressed in independent blocks of at most COMPRESS_BLOCK_SIZE
+ * bytes with a small LZ77 coder, so decompression needs one block of memory
+ * and can write each block to its destination as soon as it is decoded.
+ *
+ * Each block starts with its raw and stored sizes (32-bit, host byte order).
+ * A block that does not shrink is stored as is, with equal sizes. Compressed
+ * blocks are a series of sequences: a token byte holding the literal count in
+ * its high nibble and the match length minus COMPRESS_MIN_MATCH in its low
+ * nibble (15 meaning more length bytes follow), the literals, then a 16-bit
+ * little-endian match offset. The last sequence has literals only.
+ *
+ * The level sets how many earlier positions with the same hash are tried for
+ * each match: one at level 1, doubling per level up to 256 at level 9. After
+ * every 2^COMPRESS_SKIP_LOG positions without a match the search steps one
+ * byte further, so incompressible data is passed over quickly.
+ */
+# include <stdio.h>
+# include <stdlib.h>
+# include <string.h>
+
+# include "files.h"
+# include "compress.h"
+
+# define COMPRESS_MIN_MATCH 4
+# define COMPRESS_HASH_LOG 14
+# define COMPRESS_MAX_OFFSET 65535
+# define COMPRESS_SKIP_LOG 6
+
+/**
+ * @brief Hashes the four bytes at a position.
+ */
+static uint32_t compress_hash(const uint8_t* p) {
+    uint32_t value;
+    memcpy(&value, p, sizeof(value));
+    return (value * 2654435761U) >> (32 - COMPRESS_HASH_LOG);
+}
+
+/**
+ * @brief Writes a length continuation after a saturated nibble.
+ *
+ * @param out The output position.
+ * @param end The end of the output buffer.
+ * @param length The length remaining after the nibble value of 15.
+ * @return The new output position, or NULL if the output is full.
+ */
+static uint8_t* put_length(uint8_t* out, uint8_t* end, size_t length) {
+    while (length >= 255) {
+        if (out >= end) {
+            return NULL;
+        }
+        *out++ = 255;
+        length -= 255;
+    }
+    if (out >= end) {
+        return NULL;
+    }
+    *out++ = (uint8_t)length;
+    return out;
+}
+
+/**
+ * @brief Writes one sequence of literals and an optional match.
+ *
+ * @param out The output position.
+ * @param end The end of the output buffer.
+ * @param literals The literal bytes.
+ * @param literal_length The number of literal bytes.
+ * @param offset The match offset, unused if match_length is 0.
+ * @param match_length The match length, 0 for the final literals-only sequence.
+ * @return The new output position, or NULL if the output is full.
+ */
+static uint8_t* put_sequence(uint8_t* out, uint8_t* end, const uint8_t* literals, size_t literal_length, size_t offset, size_t match_length) {
+    if (out >= end) {
+        return NULL;
+    }
+    uint8_t* token = out++;
+    size_t match_code = (match_length > 0) ? match_length - COMPRESS_MIN_MATCH : 0;
+    *token = (uint8_t)(((literal_length < 15 ? literal_length : 15) << 4) | (match_code < 15 ? match_code : 15));
+
+    if (literal_length >= 15 && (out = put_length(out, end, literal_length - 15)) == NULL) {
+        return NULL;
+    }
+    if ((size_t)(end - out) < literal_length) {
+        return NULL;
+    }
+    memcpy(out, literals, literal_length);
+    out += literal_length;
+
+    if (match_length == 0) {
+        return out;
+    }
+    if (end - out < 2) {
+        return NULL;
+    }
+    *out++ = (uint8_t)(offset & 0xff);
+    *out++ = (uint8_t)(offset >> 8);
+    if (match_code >= 15 && (out = put_length(out, end, match_code - 15)) == NULL) {
+        return NULL;
+    }
+    return out;
+}
+
+/**
+ * @brief Compresses the payload of one block.
+ *
+ * @param src The block data.
+ * @param size The block size, at most COMPRESS_BLOCK_SIZE.
+ * @param dst The output buffer.
+ * @param capacity The output capacity; compression gives up when it is reached.
+ * @param level The compression level.
+ * @return The compressed size, or 0 if the block does not fit in capacity.
+ */
+static size_t compress_payload(const uint8_t* src, size_t size, uint8_t* dst, size_t capacity, int level) {
+    // heads hold position + 1 of the latest occurrence of each hash, 0 if none
+    uint32_t* head = calloc((size_t)1 << COMPRESS_HASH_LOG, sizeof(uint32_t));
+    uint16_t* chain = malloc(COMPRESS_BLOCK_SIZE * sizeof(uint16_t));
+    if (head == NULL || chain == NULL) {
+        free(head);
+        free(chain);
+        return 0;
+    }
+
+    int depth_limit = 1 << ((level > COMPRESS_LEVEL_MAX ? COMPRESS_LEVEL_MAX : level) - 1);
+    uint8_t* out = dst;
+    uint8_t* end = dst + capacity;
+    size_t anchor = 0;
+    size_t position = 0;
+    size_t misses = 0;
+
+    while (out != NULL && position + COMPRESS_MIN_MATCH <= size) {
+        uint32_t hash = compress_hash(src + position);
+
+        // walk earlier positions with the same hash for the longest match
+        size_t best_length = 0;
+        size_t best_offset = 0;
+        uint32_t candidate = head[hash];
+        for (int depth = 0; candidate != 0 && depth < depth_limit; depth++) {
+            size_t match = candidate - 1;
+            if (position - match > COMPRESS_MAX_OFFSET) {
+                break;
+            }
+            size_t length = 0;
+            while (position + length < size && src[match + length] == src[position + length]) {
+                length++;
+            }
+            if (length > best_length) {
+                best_length = length;
+                best_offset = position - match;
+            }
+            uint16_t previous = chain[match];
+            candidate = (previous == 0 || previous - 1u >= match) ? 0 : previous;
+        }
+
+        chain[position] = (uint16_t)(head[hash] > 0xffff ? 0 : head[hash]);
+        head[hash] = (uint32_t)position + 1;
+
+        if (best_length < COMPRESS_MIN_MATCH) {
+            // step faster through data that keeps failing to match
+            position += 1 + (misses++ >> COMPRESS_SKIP_LOG);
+            continue;
+        }
+        misses = 0;
+
+        out = put_sequence(out, end, src + anchor, position - anchor, best_offset, best_length);
+
+        // higher levels also index the positions inside the match
+        size_t match_end = position + best_length;
+        if (level > 1) {
+            for (size_t i = position + 1; i + COMPRESS_MIN_MATCH <= size && i < match_end; i++) {
+                uint32_t inner = compress_hash(src + i);
+                chain[i] = (uint16_t)(head[inner] > 0xffff ? 0 : head[inner]);
+                head[inner] = (uint32_t)i + 1;
+            }
+        }
+        position = match_end;
+        anchor = position;
+    }
+
+    if (out != NULL) {
+        out = put_sequence(out, end, src + anchor, size - anchor, 0, 0);
+    }
+
+    free(head);
+    free(chain);
+    return (out == NULL) ? 0 : (size_t)(out - dst);
+}
+
+/**
+ * @brief Returns the largest possible output of compress_data for an input size.
+ *
+ * @param size The input size.
+ * @return The output buffer size to allocate.
+ */
+size_t compress_bound(size_t size) {
+    size_t blocks = (size + COMPRESS_BLOCK_SIZE - 1) / COMPRESS_BLOCK_SIZE;
+    return size + blocks * COMPRESS_BLOCK_HEADER_SIZE;
+}
+
+/**
+ * @brief Compresses one block, storing it as is if it does not shrink.
+ *
+ * @param src The block data.
+ * @param size The block size, at most COMPRESS_BLOCK_SIZE.
+ * @param dst The output buffer, at least COMPRESS_BLOCK_HEADER_SIZE + size bytes.
+ * @param level The compression level.
+ * @return The number of bytes written, including the block header.
+ */
+size_t compress_block(const uint8_t* src, size_t size, uint8_t* dst, int level) {
+    size_t stored = compress_payload(src, size, dst + COMPRESS_BLOCK_HEADER_SIZE, size > 0 ? size - 1 : 0, level);
+    if (stored == 0) {
+        memcpy(dst + COMPRESS_BLOCK_HEADER_SIZE, src, size);
+        stored = size;
+    }
+
+    uint32_t sizes[2] = { (uint32_t)size, (uint32_t)stored };
+    memcpy(dst, sizes, sizeof(sizes));
+    return COMPRESS_BLOCK_HEADER_SIZE + stored;
+}
+
+/**
+ * @brief Compresses a buffer as a series of independent blocks.
+ *
+ * @param data The data to compress.
+ * @param size The number of bytes in data.
+ * @param out The output buffer, at least compress_bound(size) bytes.
+ * @param level The compression level.
+ * @return The number of bytes written.
+ */
+size_t compress_data(const void* data, size_t size, void* out, int level) {
+    const uint8_t* src = (const uint8_t*)data;
+    uint8_t* dst = (uint8_t*)out;
+    size_t written = 0;
+    for (size_t offset = 0; offset < size; offset += COMPRESS_BLOCK_SIZE) {
+        size_t block = (size - offset < COMPRESS_BLOCK_SIZE) ? size - offset : COMPRESS_BLOCK_SIZE;
+        written += compress_block(src + offset, block, dst + written, level);
+    }
+    return written;
+}
+
+/**
+ * @brief Decodes the payload of one compressed block.
+ *
+ * @param src The compressed payload.
+ * @param size The payload size.
+ * @param dst The output buffer.
+ * @param raw_size The expected decoded size.
+ * @return 1 if the block decoded to exactly raw_size bytes, 0 if it is corrupt.
+ */
+static int decompress_payload(const uint8_t* src, size_t size, uint8_t* dst, size_t raw_size) {
+    const uint8_t* in = src;
+    const uint8_t* in_end = src + size;
+    size_t out = 0;
+
+    while (in < in_end) {
+        uint8_t token = *in++;
+
+        // literals
+        size_t literal_length = token >> 4;
+        if (literal_length == 15) {
+            uint8_t more;
+            do {
+                if (in >= in_end) {
+                    return 0;
+                }
+                more = *in++;
+                literal_length += more;
+            } while (more == 255);
+        }
+        if ((size_t)(in_end - in) < literal_length || raw_size - out < literal_length) {
+            return 0;
+        }
+        memcpy(dst + out, in, literal_length);
+        in += literal_length;
+        out += literal_length;
+
+        // the final sequence has no match
+        if (in == in_end) {
+            break;
+        }
+
+        // match
+        if (in_end - in < 2) {
+            return 0;
+        }
+        size_t offset = (size_t)in[0] | ((size_t)in[1] << 8);
+        in += 2;
+        size_t match_length = (token & 0x0f);
+        if (match_length == 15) {
+            uint8_t more;
+            do {
+                if (in >= in_end) {
+                    return 0;
+                }
+                more = *in++;
+                match_length += more;
+            } while (more == 255);
+        }
+        match_length += COMPRESS_MIN_MATCH;
+        if (offset == 0 || offset > out || raw_size - out < match_length) {
+            return 0;
+        }
+
+        // byte by byte, since the match may overlap its own output
+        for (size_t i = 0; i < match_length; i++) {
+            dst[out + i] = dst[out - offset + i];
+        }
+        out += match_length;
+    }
+    return (out == raw_size);
+}
+
+/**
+ * @brief Decompresses a series of blocks and writes the result to a file descriptor.
+ *
+ * Only one block is held in memory at a time.
+ *
+ * @param data The compressed data.
+ * @param stored_size The number of bytes in data.
+ * @param raw_size The expected decompressed size.
+ * @param fd The file descriptor to write to.
+ * @return 1 if the data was decompressed and written successfully, 0 otherwise.
+ */
+int decompress_to_fd(const void* data, size_t stored_size, uint64_t raw_size, int fd) {
+    const uint8_t* in = (const uint8_t*)data;
+    const uint8_t* in_end = in + stored_size;
+    uint8_t* block = malloc(COMPRESS_BLOCK_SIZE);
+    if (block == NULL) {
+        return 0;
+    }
+
+    uint64_t total = 0;
+    int ok = 1;
+    while (ok && in < in_end) {
+        uint32_t sizes[2];
+        if ((size_t)(in_end - in) < COMPRESS_BLOCK_HEADER_SIZE) {
+            ok = 0;
+            break;
+        }
+        memcpy(sizes, in, sizeof(sizes));
+        in += COMPRESS_BLOCK_HEADER_SIZE;
+        if (sizes[0] > COMPRESS_BLOCK_SIZE || sizes[1] > (size_t)(in_end - in)) {
+            ok = 0;
+            break;
+        }
+
+        if (sizes[0] == sizes[1]) {
+            // stored block
+            ok = write_bytes(fd, in, sizes[0]);
+        } else {
+            ok = decompress_payload(in, sizes[1], block, sizes[0]) && write_bytes(fd, block, sizes[0]);
+        }
+        in += sizes[1];
+        total += sizes[0];
+    }
+
+    free(block);
+    return ok && total == raw_size;
+}
+
+/**
+ * @brief Decompresses a series of blocks into a buffer.
+ *
+ * @param data The compressed data.
+ * @param stored_size The number of bytes in data.
+ * @param out The output buffer, at least raw_size bytes.
+ * @param raw_size The expected decompressed size.
+ * @return 1 if the data decompressed to exactly raw_size bytes, 0 if it is corrupt.
+ */
+int decompress_data(const void* data, size_t stored_size, void* out, uint64_t raw_size) {
+    const uint8_t* in = (const uint8_t*)data;
+    const uint8_t* in_end = in + stored_size;
+    uint8_t* dst = (uint8_t*)out;
+
+    uint64_t total = 0;
+    while (in < in_end) {
+        uint32_t sizes[2];
+        if ((size_t)(in_end - in) < COMPRESS_BLOCK_HEADER_SIZE) {
+            return 0;
+        }
+        memcpy(sizes, in, sizeof(sizes));
+        in += COMPRESS_BLOCK_HEADER_SIZE;
+        if (sizes[0] > COMPRESS_BLOCK_SIZE || sizes[1] > (size_t)(in_end - in) || sizes[0] > raw_size - total) {
+            return 0;
+        }
+
+        if (sizes[0] == sizes[1]) {
+            // stored block
+            memcpy(dst + total, in, sizes[0]);
+        } else if (decompress_payload(in, sizes[1], dst + total, sizes[0]) == 0) {
+            return 0;
+        }
+        in += sizes[1];
+        total += sizes[0];
+    }
+    return (total == raw_size);
+}
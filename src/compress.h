@@ -0,0 +1,20 @@
+# ifndef __COMPRESS_H__
+# define __COMPRESS_H__
+
+# include <stddef.h>
+# include <stdint.h>
+
+/// Settings
+# define COMPRESS_BLOCK_SIZE 65536
+# define COMPRESS_BLOCK_HEADER_SIZE 8
+# define COMPRESS_LEVEL_DEFAULT 1
+# define COMPRESS_LEVEL_MAX 9
+
+// function prototypes
+size_t compress_bound(size_t size);
+size_t compress_block(const uint8_t* src, size_t size, uint8_t* dst, int level);
+size_t compress_data(const void* data, size_t size, void* out, int level);
+int decompress_to_fd(const void* data, size_t stored_size, uint64_t raw_size, int fd);
+int decompress_data(const void* data, size_t stored_size, void* out, uint64_t raw_size);
+
+# endif
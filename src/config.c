@@ -0,0 +1,82 @@
+/**
+ * @file config.c
+ * @brief Repository settings for the VCS (Version Control System).
+ *
+ * Settings are "key=value" lines in the config file, with integer values.
+ * A missing file or key yields the caller's fallback, so repositories created
+ * before a setting existed keep their old behaviour.
+ */
+# include <stdio.h>
+# include <stdlib.h>
+# include <string.h>
+# include <inttypes.h>
+
+# include "validations.h"
+# include "files.h"
+# include "config.h"
+# include "journal.h"
+
+/**
+ * @brief Reads an integer setting.
+ *
+ * @param key The setting name.
+ * @param fallback The value to return if the setting is not present.
+ * @return The setting value, or fallback.
+ */
+int64_t config_get(const char* key, int64_t fallback) {
+    FILE* config_file = fopen(CONFIG_FILE, "r");
+    if (config_file == NULL) {
+        return fallback;
+    }
+
+    // read lines
+    char buffer[256];
+    size_t key_length = strlen(key);
+    int64_t value = fallback;
+    while (fgets(buffer, sizeof(buffer), config_file)) {
+        if (strncmp(buffer, key, key_length) == 0 && buffer[key_length] == '=') {
+            value = strtoll(buffer + key_length + 1, NULL, 10);
+        }
+    }
+
+    fclose(config_file);
+    return value;
+}
+
+/**
+ * @brief Writes an integer setting, replacing any previous value.
+ *
+ * The file is rewritten to a temporary file and renamed into place.
+ *
+ * @param key The setting name.
+ * @param value The setting value.
+ * @return 1 if the setting was written successfully, 0 otherwise.
+ */
+int config_set(const char* key, int64_t value) {
+    FILE* output = open_file(CONFIG_FILE ".tmp", "w");
+    if (output == NULL) {
+        return 0;
+    }
+
+    // copy other settings
+    FILE* config_file = fopen(CONFIG_FILE, "r");
+    if (config_file != NULL) {
+        char buffer[256];
+        size_t key_length = strlen(key);
+        while (fgets(buffer, sizeof(buffer), config_file)) {
+            if (strncmp(buffer, key, key_length) == 0 && buffer[key_length] == '=') {
+                continue;
+            }
+            fputs(buffer, output);
+        }
+        fclose(config_file);
+    }
+
+    fprintf(output, "%s=%" PRId64 "\n", key, value);
+    int synced = journal_sync_file(output);
+    if (fclose(output) != 0 || !synced || rename(CONFIG_FILE ".tmp", CONFIG_FILE) != 0) {
+        remove(CONFIG_FILE ".tmp");
+        return 0;
+    }
+    return 1;
+}
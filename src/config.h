@@ -0,0 +1,15 @@
+# ifndef __CONFIG_H__
+# define __CONFIG_H__
+
+# include <stdint.h>
+
+/// Keys
+# define CONFIG_FRAMED_SINCE "contents.framed_since"
+# define CONFIG_COMPRESSION_LEVEL "compression.level"
+# define CONFIG_JOURNAL_SYNC "journal.sync"
+
+// function prototypes
+int64_t config_get(const char* key, int64_t fallback);
+int config_set(const char* key, int64_t value);
+
+# endif
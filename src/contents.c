@@ -0,0 +1,494 @@
+/**
+ * @file contents.c
+ * @brief Blob records in the contents file for the VCS (Version Control System).
+ *
+ * Blobs are appended as records: a fixed RecordHeader carrying explicit
+ * sizes, followed by the payload bytes. Any byte sequence round-trips, since
+ * nothing depends on terminators. Blobs stored before records existed are raw
+ * byte ranges; the config setting CONFIG_FRAMED_SINCE holds the offset where
+ * records begin.
+ *
+ * The contents file is mapped once per process, on first use, and byte ranges
+ * are handed out as pointers into the mapping. Readers write those ranges
+ * straight to their destination without opening the file or copying through
+ * intermediate buffers. Delta records are the exception: they are rebuilt in
+ * memory from their base first. Chunked records list the chunks of a large
+ * file, each stored as a blob of its own.
+ */
+# include <stdio.h>
+# include <stdlib.h>
+# include <string.h>
+# include <inttypes.h>
+# include <fcntl.h>
+# include <unistd.h>
+# include <sys/mman.h>
+# include <sys/stat.h>
+
+# include "validations.h"
+# include "files.h"
+# include "config.h"
+# include "compress.h"
+# include "delta.h"
+# include "contents.h"
+
+static int contents_fd = -1;
+static char* contents_map = NULL;
+static size_t contents_size = 0;
+static int append_fd = -1;
+static int64_t framed_since = -1;
+static int close_registered = 0;
+
+/**
+ * @brief Releases the contents file at exit, registering the handler only once.
+ */
+static void contents_register_close() {
+    if (close_registered == 0) {
+        atexit(contents_close);
+        close_registered = 1;
+    }
+}
+
+/**
+ * @brief Returns the offset where blob records begin.
+ *
+ * @return The offset, or INT64_MAX if no record has been written yet.
+ */
+static int64_t contents_framed_since() {
+    if (framed_since < 0) {
+        framed_since = config_get(CONFIG_FRAMED_SINCE, INT64_MAX);
+    }
+    return framed_since;
+}
+
+/**
+ * @brief Maps the contents file, or remaps it if it has grown past the current mapping.
+ *
+ * @return 1 if the mapping is available, 0 otherwise.
+ */
+static int contents_remap() {
+    if (contents_fd < 0) {
+        contents_fd = open(CONTENTS_FILE, O_RDONLY);
+        if (contents_fd < 0) {
+            printf("vcs: error: could not open %s file\n", CONTENTS_FILE);
+            return 0;
+        }
+        contents_register_close();
+    }
+
+    struct stat st;
+    if (fstat(contents_fd, &st) != 0) {
+        return 0;
+    }
+    if ((size_t)st.st_size == contents_size) {
+        return 1;
+    }
+
+    if (contents_map != NULL) {
+        munmap(contents_map, contents_size);
+        contents_map = NULL;
+        contents_size = 0;
+    }
+    if (st.st_size == 0) {
+        return 1;
+    }
+
+    void* map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, contents_fd, 0);
+    if (map == MAP_FAILED) {
+        printf("vcs: error: could not map %s file\n", CONTENTS_FILE);
+        return 0;
+    }
+    contents_map = (char*)map;
+    contents_size = (size_t)st.st_size;
+    return 1;
+}
+
+/**
+ * @brief Returns a pointer to a byte range of the contents file.
+ *
+ * @param start_byte The first byte of the range.
+ * @param end_byte The byte after the last byte of the range.
+ * @return A pointer into the read-only mapping, or NULL if the range is outside the file.
+ */
+const char* contents_range(int64_t start_byte, int64_t end_byte) {
+    if (start_byte < 0 || end_byte < start_byte) {
+        return NULL;
+    }
+    if ((uint64_t)end_byte > contents_size && contents_remap() == 0) {
+        return NULL;
+    }
+    if ((uint64_t)end_byte > contents_size) {
+        printf("vcs: error: byte range %" PRId64 "-%" PRId64 " is outside %s\n", start_byte, end_byte, CONTENTS_FILE);
+        return NULL;
+    }
+    if (start_byte == end_byte) {
+        return "";
+    }
+    return contents_map + start_byte;
+}
+
+/**
+ * @brief Maps the contents file as it is now and fixes where records begin.
+ *
+ * Blobs stored before the call can then be read by several threads while
+ * one thread appends: reading them never remaps the file, and appending no
+ * longer changes where records begin. In a repository without records yet,
+ * records begin at the current end of the file.
+ *
+ * @return 1 on success, 0 otherwise.
+ */
+int contents_prepare(void) {
+    if (contents_framed_since() == INT64_MAX) {
+        struct stat st;
+        int64_t offset = (stat(CONTENTS_FILE, &st) == 0) ? (int64_t)st.st_size : 0;
+        if (config_set(CONFIG_FRAMED_SINCE, offset) == 0) {
+            printf("vcs: error: could not write %s\n", CONFIG_FILE);
+            return 0;
+        }
+        framed_since = offset;
+    }
+    return contents_remap();
+}
+
+/**
+ * @brief Appends a blob record to the contents file.
+ *
+ * @param type The record type.
+ * @param depth The delta chain depth, 0 for records that are not deltas.
+ * @param data The payload.
+ * @param stored_size The number of payload bytes.
+ * @param raw_size The size of the blob once decoded.
+ * @param start_byte Receives the offset of the record.
+ * @param end_byte Receives the offset just after the record.
+ * @return 1 if the record was appended successfully, 0 otherwise.
+ */
+int contents_append(uint8_t type, uint8_t depth, const void* data, size_t stored_size, uint64_t raw_size, int64_t* start_byte, int64_t* end_byte) {
+    if (append_fd < 0) {
+        append_fd = open(CONTENTS_FILE, O_WRONLY | O_APPEND | O_CREAT, 0666);
+        if (append_fd < 0) {
+            printf("vcs: error: could not open %s file\n", CONTENTS_FILE);
+            return 0;
+        }
+        contents_register_close();
+    }
+
+    off_t offset = lseek(append_fd, 0, SEEK_END);
+    if (offset < 0) {
+        return 0;
+    }
+
+    // the first record of a repository marks where records begin
+    if (contents_framed_since() == INT64_MAX) {
+        if (config_set(CONFIG_FRAMED_SINCE, (int64_t)offset) == 0) {
+            printf("vcs: error: could not write %s\n", CONFIG_FILE);
+            return 0;
+        }
+        framed_since = (int64_t)offset;
+    }
+
+    RecordHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, RECORD_MAGIC, 4);
+    header.type = type;
+    header.depth = depth;
+    header.stored_size = (uint64_t)stored_size;
+    header.raw_size = raw_size;
+
+    if (write_bytes(append_fd, &header, sizeof(header)) == 0 || write_bytes(append_fd, data, stored_size) == 0) {
+        printf("vcs: error: could not append to %s\n", CONTENTS_FILE);
+        return 0;
+    }
+
+    *start_byte = (int64_t)offset;
+    *end_byte = (int64_t)offset + (int64_t)sizeof(header) + (int64_t)stored_size;
+    return 1;
+}
+
+/**
+ * @brief Returns the payload of a blob record after validating its header.
+ *
+ * @param start_byte The start of the record in the contents file.
+ * @param end_byte The end of the record in the contents file.
+ * @param header Receives the record header.
+ * @return A pointer to the payload, or NULL if the record is corrupt.
+ */
+static const char* contents_record(int64_t start_byte, int64_t end_byte, RecordHeader* header) {
+    const char* record = contents_range(start_byte, end_byte);
+    if (record == NULL || end_byte - start_byte < (int64_t)sizeof(RecordHeader)) {
+        return NULL;
+    }
+
+    memcpy(header, record, sizeof(*header));
+    if (memcmp(header->magic, RECORD_MAGIC, 4) != 0
+        || header->stored_size != (uint64_t)(end_byte - start_byte) - sizeof(*header)) {
+        printf("vcs: error: corrupt record at byte %" PRId64 " of %s\n", start_byte, CONTENTS_FILE);
+        return NULL;
+    }
+    return record + sizeof(*header);
+}
+
+/**
+ * @brief Rebuilds a delta record on top of its base blob.
+ *
+ * The payload starts with the byte range of the base blob, which always lies
+ * before the delta record, followed by the delta instructions.
+ *
+ * @param start_byte The start of the record, for error messages.
+ * @param header The record header.
+ * @param payload The record payload.
+ * @return The rebuilt blob, which must be freed, or NULL on failure.
+ */
+static char* contents_apply_delta(int64_t start_byte, const RecordHeader* header, const char* payload) {
+    int64_t base_range[2];
+    if (header->stored_size < sizeof(base_range)) {
+        return NULL;
+    }
+    memcpy(base_range, payload, sizeof(base_range));
+    if (base_range[1] > start_byte) {
+        printf("vcs: error: corrupt delta record at byte %" PRId64 " of %s\n", start_byte, CONTENTS_FILE);
+        return NULL;
+    }
+
+    size_t base_size;
+    char* base = contents_read_blob(base_range[0], base_range[1], &base_size);
+    if (base == NULL) {
+        return NULL;
+    }
+
+    char* content = malloc((size_t)header->raw_size + 1);
+    if (content != NULL && delta_apply((const uint8_t*)base, base_size, (const uint8_t*)payload + sizeof(base_range),
+                                       (size_t)header->stored_size - sizeof(base_range), (uint8_t*)content, (size_t)header->raw_size) == 0) {
+        printf("vcs: error: corrupt delta record at byte %" PRId64 " of %s\n", start_byte, CONTENTS_FILE);
+        free(content);
+        content = NULL;
+    }
+    free(base);
+    return content;
+}
+
+/**
+ * @brief Returns the chunk list of a chunked record after checking it.
+ *
+ * The payload is a list of chunk byte ranges, each a pair of 64-bit offsets,
+ * all of which lie before the chunked record.
+ *
+ * @param start_byte The start of the record.
+ * @param header The record header.
+ * @param payload The record payload.
+ * @param count Receives the number of chunks.
+ * @return A pointer to the chunk ranges, or NULL if the record is corrupt.
+ */
+static const char* contents_chunks(int64_t start_byte, const RecordHeader* header, const char* payload, size_t* count) {
+    size_t entry = 2 * sizeof(int64_t);
+    if (header->stored_size % entry != 0) {
+        printf("vcs: error: corrupt chunked record at byte %" PRId64 " of %s\n", start_byte, CONTENTS_FILE);
+        return NULL;
+    }
+    *count = (size_t)header->stored_size / entry;
+    for (size_t i = 0; i < *count; i++) {
+        int64_t range[2];
+        memcpy(range, payload + i * entry, sizeof(range));
+        if (range[1] > start_byte) {
+            printf("vcs: error: corrupt chunked record at byte %" PRId64 " of %s\n", start_byte, CONTENTS_FILE);
+            return NULL;
+        }
+    }
+    return payload;
+}
+
+/**
+ * @brief Rebuilds a chunked record in memory.
+ *
+ * @param start_byte The start of the record.
+ * @param header The record header.
+ * @param payload The record payload.
+ * @return The rebuilt blob, which must be freed, or NULL on failure.
+ */
+static char* contents_join_chunks(int64_t start_byte, const RecordHeader* header, const char* payload) {
+    size_t count;
+    const char* chunks = contents_chunks(start_byte, header, payload, &count);
+    char* content = (chunks != NULL) ? malloc((size_t)header->raw_size + 1) : NULL;
+    if (content == NULL) {
+        return NULL;
+    }
+
+    size_t written = 0;
+    for (size_t i = 0; i < count; i++) {
+        int64_t range[2];
+        memcpy(range, chunks + i * sizeof(range), sizeof(range));
+        size_t size;
+        char* chunk = contents_read_blob(range[0], range[1], &size);
+        if (chunk == NULL || size > header->raw_size - written) {
+            free(chunk);
+            free(content);
+            return NULL;
+        }
+        memcpy(content + written, chunk, size);
+        written += size;
+        free(chunk);
+    }
+    if (written != header->raw_size) {
+        printf("vcs: error: corrupt chunked record at byte %" PRId64 " of %s\n", start_byte, CONTENTS_FILE);
+        free(content);
+        return NULL;
+    }
+    return content;
+}
+
+/**
+ * @brief Writes the contents of a stored blob to a file descriptor.
+ *
+ * @param start_byte The start of the blob in the contents file.
+ * @param end_byte The end of the blob in the contents file.
+ * @param fd The file descriptor to write to.
+ * @return 1 if the blob was written successfully, 0 otherwise.
+ */
+int contents_write_blob(int64_t start_byte, int64_t end_byte, int fd) {
+    // blobs stored before records existed are raw ranges
+    if (start_byte < contents_framed_since()) {
+        const char* data = contents_range(start_byte, end_byte);
+        return (data != NULL) && write_bytes(fd, data, (size_t)(end_byte - start_byte));
+    }
+
+    RecordHeader header;
+    const char* payload = contents_record(start_byte, end_byte, &header);
+    if (payload == NULL) {
+        return 0;
+    }
+
+    switch (header.type) {
+        case RECORD_RAW:
+            return write_bytes(fd, payload, (size_t)header.stored_size);
+        case RECORD_COMPRESSED:
+            if (decompress_to_fd(payload, (size_t)header.stored_size, header.raw_size, fd) == 0) {
+                printf("vcs: error: corrupt compressed record at byte %" PRId64 " of %s\n", start_byte, CONTENTS_FILE);
+                return 0;
+            }
+            return 1;
+        case RECORD_DELTA: {
+            char* content = contents_apply_delta(start_byte, &header, payload);
+            int written = (content != NULL) && write_bytes(fd, content, (size_t)header.raw_size);
+            free(content);
+            return written;
+        }
+        case RECORD_CHUNKED: {
+            // chunks are written one at a time
+            size_t count;
+            const char* chunks = contents_chunks(start_byte, &header, payload, &count);
+            if (chunks == NULL) {
+                return 0;
+            }
+            for (size_t i = 0; i < count; i++) {
+                int64_t range[2];
+                memcpy(range, chunks + i * sizeof(range), sizeof(range));
+                if (contents_write_blob(range[0], range[1], fd) == 0) {
+                    return 0;
+                }
+            }
+            return 1;
+        }
+        default:
+            printf("vcs: error: unknown record type %d at byte %" PRId64 "\n", header.type, start_byte);
+            return 0;
+    }
+}
+
+/**
+ * @brief Reads a stored blob into memory.
+ *
+ * @param start_byte The start of the blob in the contents file.
+ * @param end_byte The end of the blob in the contents file.
+ * @param size Receives the size of the blob.
+ * @return The blob contents, NUL-terminated, which must be freed, or NULL on failure.
+ */
+char* contents_read_blob(int64_t start_byte, int64_t end_byte, size_t* size) {
+    // blobs stored before records existed are raw ranges
+    if (start_byte < contents_framed_since()) {
+        const char* data = contents_range(start_byte, end_byte);
+        if (data == NULL) {
+            return NULL;
+        }
+        *size = (size_t)(end_byte - start_byte);
+        char* content = malloc(*size + 1);
+        if (content != NULL) {
+            memcpy(content, data, *size);
+            content[*size] = '\0';
+        }
+        return content;
+    }
+
+    RecordHeader header;
+    const char* payload = contents_record(start_byte, end_byte, &header);
+    if (payload == NULL) {
+        return NULL;
+    }
+
+    char* content = NULL;
+    switch (header.type) {
+        case RECORD_RAW:
+            content = malloc((size_t)header.stored_size + 1);
+            if (content != NULL) {
+                memcpy(content, payload, (size_t)header.stored_size);
+            }
+            break;
+        case RECORD_COMPRESSED:
+            content = malloc((size_t)header.raw_size + 1);
+            if (content != NULL && decompress_data(payload, (size_t)header.stored_size, content, header.raw_size) == 0) {
+                printf("vcs: error: corrupt compressed record at byte %" PRId64 " of %s\n", start_byte, CONTENTS_FILE);
+                free(content);
+                content = NULL;
+            }
+            break;
+        case RECORD_DELTA:
+            content = contents_apply_delta(start_byte, &header, payload);
+            break;
+        case RECORD_CHUNKED:
+            content = contents_join_chunks(start_byte, &header, payload);
+            break;
+        default:
+            printf("vcs: error: unknown record type %d at byte %" PRId64 "\n", header.type, start_byte);
+            break;
+    }
+
+    if (content != NULL) {
+        *size = (size_t)header.raw_size;
+        content[*size] = '\0';
+    }
+    return content;
+}
+
+/**
+ * @brief Returns how many deltas must be applied to rebuild a stored blob.
+ *
+ * @param start_byte The start of the blob in the contents file.
+ * @param end_byte The end of the blob in the contents file.
+ * @return The delta chain depth, 0 for full blobs, or -1 if the record is corrupt.
+ */
+int contents_blob_depth(int64_t start_byte, int64_t end_byte) {
+    if (start_byte < contents_framed_since()) {
+        return 0;
+    }
+    RecordHeader header;
+    if (contents_record(start_byte, end_byte, &header) == NULL) {
+        return -1;
+    }
+    return (header.type == RECORD_DELTA) ? header.depth : 0;
+}
+
+/**
+ * @brief Releases the mapping and append handle of the contents file.
+ */
+void contents_close(void) {
+    if (append_fd >= 0) {
+        close(append_fd);
+        append_fd = -1;
+    }
+    if (contents_map != NULL) {
+        munmap(contents_map, contents_size);
+        contents_map = NULL;
+    }
+    contents_size = 0;
+    if (contents_fd >= 0) {
+        close(contents_fd);
+        contents_fd = -1;
+    }
+}
@@ -0,0 +1,39 @@
+# ifndef __CONTENTS_H__
+# define __CONTENTS_H__
+
+# include <stddef.h>
+# include <stdint.h>
+
+/// Records
+# define RECORD_MAGIC "VCSB"
+# define RECORD_RAW 0
+# define RECORD_COMPRESSED 1
+# define RECORD_DELTA 2
+# define RECORD_CHUNKED 3
+
+typedef struct record_header RecordHeader;
+
+/**
+ * Header in front of every blob record written to the contents file. Sizes
+ * are stored in host byte order. Delta records count how many deltas must be
+ * applied to rebuild them in depth; other records have a depth of 0.
+ */
+struct record_header {
+    char magic[4];
+    uint8_t type;
+    uint8_t depth;
+    uint8_t reserved[2];
+    uint64_t stored_size;
+    uint64_t raw_size;
+};
+
+// function prototypes
+const char* contents_range(int64_t start_byte, int64_t end_byte);
+int contents_prepare(void);
+int contents_append(uint8_t type, uint8_t depth, const void* data, size_t stored_size, uint64_t raw_size, int64_t* start_byte, int64_t* end_byte);
+int contents_write_blob(int64_t start_byte, int64_t end_byte, int fd);
+char* contents_read_blob(int64_t start_byte, int64_t end_byte, size_t* size);
+int contents_blob_depth(int64_t start_byte, int64_t end_byte);
+void contents_close(void);
+
+# endif
@@ -2,330 +2,389 @@
  * @file data_structures.c
  * @brief Data structures for the VCS (Version Control System).
  *
- * This file contains the code for the data structures used in the VCS,
- * including the commit data structure and the file data structure.
+ * This file contains the code for the data structures used in the VCS: the
+ * commit table and the file table. Both store each field in its own
+ * contiguous column, so log and lookups walk arrays instead of chasing list
+ * pointers.
  */
 
 # include <stdio.h>
 # include <stdlib.h>
 # include <string.h>
+# include <inttypes.h>
 # include <unistd.h>
+# include <sys/mman.h>
 # include <sys/stat.h>
 
 # include "data_structures.h"
 # include "parser.h"
 
 /**
- * @brief Creates a new commit list head.
+ * @brief Moves a column to a larger allocation in the arena.
  *
- * @return A pointer to the newly created CommitHead.
+ * @param arena The arena.
+ * @param column The current column, or NULL.
+ * @param count The number of elements in use.
+ * @param capacity The new number of elements.
+ * @param element The size of one element.
+ * @return The new column.
  */
-// function prototypes
-CommitHead* commit_create() {
-    CommitHead* head = (CommitHead*)malloc(sizeof(CommitHead));
-    if (head == NULL)
-        return head;
-    head->first = NULL;
-    head->last = NULL;
-    return head;
+static void* grow_column(Arena* arena, void* column, size_t count, size_t capacity, size_t element) {
+    void* grown = arena_alloc(arena, capacity * element);
+    if (grown == NULL) {
+        printf("vcs: error: could not allocate memory\n");
+        exit(EXIT_FAILURE);
+    }
+    if (count > 0) {
+        memcpy(grown, column, count * element);
+    }
+    return grown;
+}
+
+/**
+ * @brief Initializes an empty file table.
+ *
+ * @param table The file table.
+ * @param arena The arena that holds the table.
+ */
+static void file_table_init(FileTable* table, Arena* arena) {
+    table->count = 0;
+    table->capacity = 0;
+    table->paths = NULL;
+    table->digests = NULL;
+    table->start_bytes = NULL;
+    table->end_bytes = NULL;
+    table->arena = arena;
+    table->borrowed = 0;
 }
 
 /**
- * @brief Inserts a commit into the commit list.
+ * @brief Creates a new commit table.
  *
- * @param head The commit list head.
+ * @param arena The arena that holds the table.
+ * @return A pointer to the newly created CommitTable.
+ */
+CommitTable* commit_table_create(Arena* arena) {
+    CommitTable* table = (CommitTable*)arena_alloc(arena, sizeof(CommitTable));
+    if (table == NULL)
+        return table;
+    table->count = 0;
+    table->capacity = 0;
+    table->ids = NULL;
+    table->timestamps = NULL;
+    table->start_bytes = NULL;
+    table->end_bytes = NULL;
+    table->file_starts = NULL;
+    table->file_counts = NULL;
+    table->hashes = NULL;
+    table->dates = NULL;
+    table->messages = NULL;
+    file_table_init(&table->files, arena);
+    table->arena = arena;
+    table->map = NULL;
+    table->map_size = 0;
+    return table;
+}
+
+/**
+ * @brief Makes room for at least the given number of commits.
+ *
+ * @param table The commit table.
+ * @param capacity The number of commits to make room for.
+ */
+void commit_table_reserve(CommitTable* table, size_t capacity) {
+    if (capacity <= table->capacity) {
+        return;
+    }
+    Arena* arena = table->arena;
+    size_t n = table->count;
+    table->ids = grow_column(arena, table->ids, n, capacity, sizeof(*table->ids));
+    table->timestamps = grow_column(arena, table->timestamps, n, capacity, sizeof(int64_t));
+    table->start_bytes = grow_column(arena, table->start_bytes, n, capacity, sizeof(int64_t));
+    table->end_bytes = grow_column(arena, table->end_bytes, n, capacity, sizeof(int64_t));
+    table->file_starts = grow_column(arena, table->file_starts, n, capacity, sizeof(size_t));
+    table->file_counts = grow_column(arena, table->file_counts, n, capacity, sizeof(size_t));
+    table->hashes = grow_column(arena, table->hashes, n, capacity, sizeof(char*));
+    table->dates = grow_column(arena, table->dates, n, capacity, sizeof(char*));
+    table->messages = grow_column(arena, table->messages, n, capacity, sizeof(char*));
+    table->capacity = capacity;
+}
+
+/**
+ * @brief Appends a commit to the commit table.
+ *
+ * Strings are copied, unless the table was parsed from a mapping of the
+ * commits file, in which case they already point into it. The files of the
+ * commit must already be in the file table.
+ *
+ * @param table The commit table.
+ * @param id The binary commit identifier.
  * @param hash The hash of the commit.
  * @param date The date of the commit.
  * @param message The commit message.
+ * @param timestamp The commit time.
  * @param start_byte The start byte position of the commit.
  * @param end_byte The end byte position of the commit.
+ * @param file_start The first row of the commit in the file table.
+ * @param file_count The number of files of the commit.
+ * @return The row of the new commit.
  */
-void commit_insert(CommitHead* head, char* hash, char* date, const char* message, int start_byte, int end_byte) {
-    Commit* commit = (Commit*)malloc(sizeof(Commit));
-    if (commit == NULL)
-        return;
-    
-    commit->hash = (char*)malloc(sizeof(char) * (strlen(hash) + 1));
-    strcpy(commit->hash, hash);
-    commit->date = (char*)malloc(sizeof(char) * (strlen(date) + 1));
-    strcpy(commit->date, date);
-    commit->message = (char*)malloc(sizeof(char) * (strlen(message) + 1));
-    strcpy(commit->message, message);
-    commit->start_byte = start_byte;
-    commit->end_byte = end_byte;
+size_t commit_table_append(CommitTable* table, const uint8_t id[DIGEST_SIZE], char* hash, char* date, const char* message, int64_t timestamp, int64_t start_byte, int64_t end_byte, size_t file_start, size_t file_count) {
+    if (table->count == table->capacity) {
+        commit_table_reserve(table, (table->capacity == 0) ? 16 : table->capacity * 2);
+    }
 
-    commit->next = NULL;
-    commit->prev = NULL;
-    if (head->first == NULL) {
-        head->first = commit;
-        head->last = commit;
+    size_t row = table->count++;
+    memcpy(table->ids[row], id, DIGEST_SIZE);
+    table->timestamps[row] = timestamp;
+    table->start_bytes[row] = start_byte;
+    table->end_bytes[row] = end_byte;
+    table->file_starts[row] = file_start;
+    table->file_counts[row] = file_count;
+    if (table->map != NULL) {
+        table->hashes[row] = hash;
+        table->dates[row] = date;
+        table->messages[row] = (char*)message;
     } else {
-        head->last->next = commit;
-        commit->prev = head->last;
-        head->last = commit;
+        table->hashes[row] = arena_strdup(table->arena, hash);
+        table->dates[row] = arena_strdup(table->arena, date);
+        table->messages[row] = arena_strdup(table->arena, message);
+    }
+    return row;
+}
+
+/**
+ * @brief Finds a file of a commit by path.
+ *
+ * @param table The commit table.
+ * @param row The row of the commit.
+ * @param path The file path.
+ * @return The row of the file in the file table, or -1 if the commit does not contain the path.
+ */
+long commit_table_find_file(const CommitTable* table, size_t row, const char* path) {
+    size_t end = table->file_starts[row] + table->file_counts[row];
+    for (size_t i = table->file_starts[row]; i < end; i++) {
+        if (strcmp(table->files.paths[i], path) == 0) {
+            return (long)i;
+        }
     }
+    return -1;
 }
 
 /**
- * @brief Displays the commits in the commit list.
+ * @brief Displays the commits in the commit table.
  *
- * @param head The commit list head.
+ * @param table The commit table.
  */
-void commit_display(CommitHead* head) {
-    Commit* aux = head->first;
-    while (aux != NULL) {
-        printf("Hash: %s\n", aux->hash);
-        printf("Date: %s\n", aux->date);
-        printf("Message: %s\n", aux->message);
-        printf("Start byte: %d\n", aux->start_byte);
-        printf("End byte: %d\n", aux->end_byte);
+void commit_display(const CommitTable* table) {
+    for (size_t i = 0; i < table->count; i++) {
+        printf("Hash: %s\n", table->hashes[i]);
+        printf("Date: %s\n", table->dates[i]);
+        printf("Message: %s\n", table->messages[i]);
+        printf("Start byte: %" PRId64 "\n", table->start_bytes[i]);
+        printf("End byte: %" PRId64 "\n", table->end_bytes[i]);
         printf("\n");
-        aux = aux->next;
     }
 }
 
 /**
- * @brief Destroys the commit list and frees the memory.
+ * @brief Releases the commits file mapping of the commit table.
  *
- * @param head The commit list head.
+ * The columns themselves are freed with the arena that holds them, so the
+ * table must not be used after its arena is destroyed.
+ *
+ * @param table The commit table.
  */
-void commit_destroy(CommitHead* head) {
-    Commit* aux = head->first;
-    while (aux != NULL) {
-        Commit* t = aux->next;
-        free(aux->hash);
-        free(aux->date);
-        free(aux->message);
-        free(aux);
-        aux = t;
+void commit_table_destroy(CommitTable* table) {
+    if (table->map != NULL) {
+        munmap(table->map, table->map_size);
+        table->map = NULL;
+        table->map_size = 0;
     }
-    free(head);
 }
 
 /**
- * @brief Creates a new file list head.
+ * @brief Creates a new file table.
  *
- * @return A pointer to the newly created FileHead.
+ * @param arena The arena that holds the table.
+ * @return A pointer to the newly created FileTable.
  */
-FileHead* file_create() {
-    FileHead* head = (FileHead*)malloc(sizeof(FileHead));
-    if (head == NULL)
-        return head;
-    head->first = NULL;
-    head->last = NULL;
-    return head;
+FileTable* file_table_create(Arena* arena) {
+    FileTable* table = (FileTable*)arena_alloc(arena, sizeof(FileTable));
+    if (table == NULL)
+        return table;
+    file_table_init(table, arena);
+    return table;
 }
 
 /**
- * @brief Inserts a file into the file list.
+ * @brief Appends a file to the file table.
+ *
+ * Strings are copied, unless the table is marked as borrowed, in which case
+ * they point into a commits file mapping that outlives the table.
  *
- * @param head The file list head.
+ * @param table The file table.
  * @param path The path of the file.
+ * @param digest The content digest of the file, or NULL for entries written before the blob store.
  * @param start_byte The start byte position of the file.
  * @param end_byte The end byte position of the file.
+ * @return The row of the new file.
  */
-void file_insert(FileHead* head, const char* path, int start_byte, int end_byte) {
-    File* file = (File*)malloc(sizeof(File));
-    if (file == NULL)
-        return;
-    
-    file->path = (char*)malloc(sizeof(char) * (strlen(path) + 1));
-    strcpy(file->path, path);
-    file->start_byte = start_byte;
-    file->end_byte = end_byte;
+size_t file_table_append(FileTable* table, const char* path, const char* digest, int64_t start_byte, int64_t end_byte) {
+    if (table->count == table->capacity) {
+        Arena* arena = table->arena;
+        size_t n = table->count;
+        size_t capacity = (table->capacity == 0) ? 16 : table->capacity * 2;
+        table->paths = grow_column(arena, table->paths, n, capacity, sizeof(char*));
+        table->digests = grow_column(arena, table->digests, n, capacity, sizeof(char*));
+        table->start_bytes = grow_column(arena, table->start_bytes, n, capacity, sizeof(int64_t));
+        table->end_bytes = grow_column(arena, table->end_bytes, n, capacity, sizeof(int64_t));
+        table->capacity = capacity;
+    }
 
-    file->next = NULL;
-    file->prev = NULL;
-    if (head->first == NULL) {
-        head->first = file;
-        head->last = file;
+    size_t row = table->count++;
+    if (table->borrowed) {
+        table->paths[row] = (char*)path;
+        table->digests[row] = (char*)digest;
     } else {
-        head->last->next = file;
-        file->prev = head->last;
-        head->last = file;
+        table->paths[row] = arena_strdup(table->arena, path);
+        table->digests[row] = (digest != NULL) ? arena_strdup(table->arena, digest) : NULL;
     }
+    table->start_bytes[row] = start_byte;
+    table->end_bytes[row] = end_byte;
+    return row;
 }
 
 /**
- * @brief Displays the files in the file list.
+ * @brief Displays the files in the file table.
  *
- * @param head The file list head.
+ * @param table The file table.
  */
-void file_display(FileHead* head) {
-    File* aux = head->first;
-    while (aux != NULL) {
-        printf("Path: %s\n", aux->path);
-        printf("Start byte: %d\n", aux->start_byte);
-        printf("End byte: %d\n", aux->end_byte);
+void file_display(const FileTable* table) {
+    for (size_t i = 0; i < table->count; i++) {
+        printf("Path: %s\n", table->paths[i]);
+        if (table->digests[i] != NULL) {
+            printf("Blob: %s\n", table->digests[i]);
+        }
+        printf("Start byte: %" PRId64 "\n", table->start_bytes[i]);
+        printf("End byte: %" PRId64 "\n", table->end_bytes[i]);
         printf("\n");
-        aux = aux->next;
-    }
-}
-
-/**
- * @brief Destroys the file list and frees the memory.
- *
- * @param head The file list head.
- */
-void file_destroy(FileHead* head) {
-    File* aux = head->first;
-    while (aux != NULL) {
-        File* t = aux->next;
-        free(aux->path);
-        free(aux);
-        aux = t;
     }
-    free(head);
 }
 
 /**
  * @brief Displays all the commits and their associated files.
  *
- * @param commit_head The commit list head.
+ * @param table The commit table.
  */
-void display_commits(CommitHead* commit_head) {
-    Commit* aux = commit_head->first;
-    while (aux != NULL) {
-        printf("Hash: %s\n", aux->hash);
-        printf("Date: %s\n", aux->date);
-        printf("Message: %s\n", aux->message);
-        printf("Start byte: %d\n", aux->start_byte);
-        printf("End byte: %d\n", aux->end_byte);
+void display_commits(const CommitTable* table) {
+    const FileTable* files = &table->files;
+    for (size_t i = 0; i < table->count; i++) {
+        printf("Hash: %s\n", table->hashes[i]);
+        printf("Date: %s\n", table->dates[i]);
+        printf("Message: %s\n", table->messages[i]);
+        printf("Start byte: %" PRId64 "\n", table->start_bytes[i]);
+        printf("End byte: %" PRId64 "\n", table->end_bytes[i]);
         printf("\n");
 
         // display files
-        File* file_aux = aux->file_head->first;
-        while (file_aux != NULL) {
-            printf("Path: %s\n", file_aux->path);
-            printf("Start byte: %d\n", file_aux->start_byte);
-            printf("End byte: %d\n", file_aux->end_byte);
+        size_t end = table->file_starts[i] + table->file_counts[i];
+        for (size_t j = table->file_starts[i]; j < end; j++) {
+            printf("Path: %s\n", files->paths[j]);
+            printf("Start byte: %" PRId64 "\n", files->start_bytes[j]);
+            printf("End byte: %" PRId64 "\n", files->end_bytes[j]);
             printf("\n");
-            file_aux = file_aux->next;
         }
-        aux = aux->next;
     }
 }
 
 /**
  * @brief Displays the commits in reverse order from the last commit.
  *
- * @param commit_head The commit list head.
+ * @param table The commit table.
  */
-void display_from_last(CommitHead* commit_head){
-    Commit* aux = commit_head->last;
-    while (aux != NULL) {
-        printf("commit %s\n", aux->hash);
-        printf("Date:   %s\n", aux->date);
+void display_from_last(const CommitTable* table) {
+    for (size_t i = table->count; i-- > 0;) {
+        printf("commit %s\n", table->hashes[i]);
+        printf("Date:   %s\n", table->dates[i]);
         printf("\n");
-        printf("\t%s\n", aux->message);
+        printf("\t%s\n", table->messages[i]);
         printf("\n");
-        aux = aux->prev;
     }
 }
 
 /**
  * @brief Displays the commits and their associated files in reverse order from the last commit.
  *
- * @param commit_head The commit list head.
+ * @param table The commit table.
  */
-void display_from_last_with_contents(CommitHead* commit_head) {
-    Commit* aux = commit_head->last;
-    while (aux != NULL) {
-        printf("commit %s\n", aux->hash);
-        printf("Date:   %s\n", aux->date);
-        printf("\n");
-        printf("\t%s\n", aux->message);
-        printf("\n");
-
-        // display files
-        File* file_aux = aux->file_head->first;
-        // iterate through files
-        while (file_aux != NULL) {
-            // display file contents
-            printf("path %s\n", file_aux->path);
-            printf("contents: \n");
-            print_text_between_bytes(file_aux->start_byte, file_aux->end_byte);
-            printf("\n");
-
-            // next file
-            file_aux = file_aux->next;
-        }
-        aux = aux->prev;
+void display_from_last_with_contents(const CommitTable* table) {
+    for (size_t i = table->count; i-- > 0;) {
+        display_commit_and_contents(table, i);
     }
 }
 
 /**
  * @brief Displays a specific commit and its associated files.
  *
- * @param commit_head The commit list head.
- * @param hash The hash of the commit to display.
+ * @param table The commit table.
+ * @param row The row of the commit to display.
  */
-void display_commit_and_contents(CommitHead* commit_head, const char* hash) {
-    Commit* aux = commit_head->first;
-    while (aux != NULL) {
-        if (strcmp(aux->hash, hash) == 0) {
-            printf("commit %s\n", aux->hash);
-            printf("Date:   %s\n", aux->date);
-            printf("\n");
-            printf("\t%s\n", aux->message);
-            printf("\n");
-
-            // display files
-            File* file_aux = aux->file_head->first;
-            while (file_aux != NULL) {
-                printf("path %s\n", file_aux->path);
-                // display file contents
-                printf("contents: \n");
-                print_text_between_bytes(file_aux->start_byte, file_aux->end_byte);
+void display_commit_and_contents(const CommitTable* table, size_t row) {
+    printf("commit %s\n", table->hashes[row]);
+    printf("Date:   %s\n", table->dates[row]);
+    printf("\n");
+    printf("\t%s\n", table->messages[row]);
+    printf("\n");
 
-                printf("\n");
+    // display files
+    const FileTable* files = &table->files;
+    size_t end = table->file_starts[row] + table->file_counts[row];
+    for (size_t i = table->file_starts[row]; i < end; i++) {
+        printf("path %s\n", files->paths[i]);
+        // display file contents
+        printf("contents: \n");
+        print_text_between_bytes(files->start_bytes[i], files->end_bytes[i]);
 
-                file_aux = file_aux->next;
-            }
-            return;
-        }
-        aux = aux->next;
+        printf("\n");
     }
-    printf("Commit not found!\n");
 }
 
 /**
  * @brief Writes a specific commit and its associated files to the current directory.
  *
- * @param commit_head The commit list head.
- * @param hash The hash of the commit to write.
+ * @param table The commit table.
+ * @param row The row of the commit to write.
+ * @return 1 if every file was written successfully, 0 otherwise.
  */
-void write_commit_and_contents(CommitHead* commit_head, const char* hash) {
-    Commit* aux = commit_head->first;
-    while (aux != NULL) {
-        if (strcmp(aux->hash, hash) == 0) {
-            FILE* file = fopen("commit.txt", "w");
-            if (file == NULL) {
-                printf("Error opening file!\n");
-                return;
-            }
-            fprintf(file, "Hash: %s\n", aux->hash);
-            fprintf(file, "Date: %s\n", aux->date);
-            fprintf(file, "Message: %s\n", aux->message);
-            fprintf(file, "Start byte: %d\n", aux->start_byte);
-            fprintf(file, "End byte: %d\n", aux->end_byte);
-            fprintf(file, "\n");
-
-            // display files
-            File* file_aux = aux->file_head->first;
-            while (file_aux != NULL) {
-                fprintf(file, "Path: %s\n", file_aux->path);
-                // display file contents
-                write_text_between_bytes(file_aux->start_byte, file_aux->end_byte, file_aux->path);
-
-                fprintf(file, "\n");
+int write_commit_and_contents(const CommitTable* table, size_t row) {
+    FILE* file = fopen("commit.txt", "w");
+    if (file == NULL) {
+        printf("Error opening file!\n");
+        return 0;
+    }
+    fprintf(file, "Hash: %s\n", table->hashes[row]);
+    fprintf(file, "Date: %s\n", table->dates[row]);
+    fprintf(file, "Message: %s\n", table->messages[row]);
+    fprintf(file, "Start byte: %" PRId64 "\n", table->start_bytes[row]);
+    fprintf(file, "End byte: %" PRId64 "\n", table->end_bytes[row]);
+    fprintf(file, "\n");
 
-                file_aux = file_aux->next;
-            }
-            fclose(file);
-            return;
+    // write files, going on past files that cannot be written
+    int ok = 1;
+    const FileTable* files = &table->files;
+    size_t end = table->file_starts[row] + table->file_counts[row];
+    for (size_t i = table->file_starts[row]; i < end; i++) {
+        fprintf(file, "Path: %s\n", files->paths[i]);
+        // write file contents
+        if (write_text_between_bytes(files->start_bytes[i], files->end_bytes[i], files->paths[i]) == 0) {
+            ok = 0;
         }
-        aux = aux->next;
+
+        fprintf(file, "\n");
+    }
+    if (fclose(file) != 0) {
+        ok = 0;
     }
-    printf("Commit not found!\n");
+    return ok;
 }
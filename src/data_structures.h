@@ -1,55 +1,71 @@
 # ifndef __DATA_STRUCTURES_H__
 # define __DATA_STRUCTURES_H__
 
-typedef struct commit_head CommitHead;
-typedef struct commit Commit;
+# include <stddef.h>
+# include <stdint.h>
 
-typedef struct file_head FileHead;
-typedef struct file File;
+# include "arena.h"
+# include "sha256.h"
 
-struct commit_head{
-    Commit* first;
-    Commit* last;
-};
+typedef struct commit_table CommitTable;
+typedef struct file_table FileTable;
 
-struct commit{
-    char* hash;
-    char* date;
-    char* message;
-    int start_byte;
-    int end_byte;
-    FileHead* file_head;
-    Commit* next;
-    Commit* prev;
+/**
+ * Files stored column by column. Columns and the strings they copy are
+ * allocated from the arena of the command; a borrowed table points into a
+ * commits file mapping instead of copying its strings.
+ */
+struct file_table {
+    size_t count;
+    size_t capacity;
+    char** paths;
+    char** digests;
+    int64_t* start_bytes;
+    int64_t* end_bytes;
+    Arena* arena;
+    int borrowed;
 };
 
-struct file_head {
-    File* first;
-    File* last;
-};
-struct file {
-    char* path;
-    int start_byte;
-    int end_byte;
-    File* next;
-    File* prev;
+/**
+ * Commits stored column by column, in commit order. The files of commit i
+ * are rows file_starts[i] to file_starts[i] + file_counts[i] - 1 of files.
+ * Commits parsed from the commits file point into a private mapping of it
+ * instead of copying their strings; map is NULL for tables built from copies.
+ */
+struct commit_table {
+    size_t count;
+    size_t capacity;
+    uint8_t (*ids)[DIGEST_SIZE];
+    int64_t* timestamps;
+    int64_t* start_bytes;
+    int64_t* end_bytes;
+    size_t* file_starts;
+    size_t* file_counts;
+    char** hashes;
+    char** dates;
+    char** messages;
+    FileTable files;
+    Arena* arena;
+    char* map;
+    size_t map_size;
 };
 
 // function prototypes
-CommitHead* commit_create();
-void commit_insert(CommitHead* head, char* hash, char* date, const char* message, int start_byte, int end_byte);
-void commit_display(CommitHead* head);
-void commit_destroy(CommitHead* head);
-
-FileHead* file_create();
-void file_insert(FileHead* head, const char* path, int start_byte, int end_byte);
-void file_display(FileHead* head);
-void file_destroy(FileHead* head);
-
-void display_commits(CommitHead* commit_head); 
-void display_from_last(CommitHead* commit_head);
-void display_from_last_with_contents(CommitHead* commit_head);
-void display_commit_and_contents(CommitHead* commit_head, const char* hash);
-void write_commit_and_contents(CommitHead* commit_head, const char* hash);
-
-# endif
\ No newline at end of file
+CommitTable* commit_table_create(Arena* arena);
+void commit_table_reserve(CommitTable* table, size_t capacity);
+size_t commit_table_append(CommitTable* table, const uint8_t id[DIGEST_SIZE], char* hash, char* date, const char* message, int64_t timestamp, int64_t start_byte, int64_t end_byte, size_t file_start, size_t file_count);
+long commit_table_find_file(const CommitTable* table, size_t row, const char* path);
+void commit_display(const CommitTable* table);
+void commit_table_destroy(CommitTable* table);
+
+FileTable* file_table_create(Arena* arena);
+size_t file_table_append(FileTable* table, const char* path, const char* digest, int64_t start_byte, int64_t end_byte);
+void file_display(const FileTable* table);
+
+void display_commits(const CommitTable* table);
+void display_from_last(const CommitTable* table);
+void display_from_last_with_contents(const CommitTable* table);
+void display_commit_and_contents(const CommitTable* table, size_t row);
+int write_commit_and_contents(const CommitTable* table, size_t row);
+
+# endif
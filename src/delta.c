@@ -0,0 +1,228 @@
+/**
+ * @file delta.c
+ * @brief Delta encoding between versions of a file for the VCS (Version Control System).
+ *
+ * A delta rebuilds a target from a base with two instructions: DELTA_COPY,
+ * followed by an offset and a length in the base, and DELTA_INSERT, followed
+ * by a length and that many literal bytes. Numbers are written as unsigned
+ * LEB128 varints.
+ *
+ * The encoder indexes the base at every DELTA_BLOCK_SIZE boundary, then looks
+ * up each target position and extends verified matches in both directions.
+ * Matches shorter than DELTA_MIN_COPY are skipped: repeated text makes many
+ * base blocks identical, and copying from the wrong one ends almost at once.
+ */
+# include <stdlib.h>
+# include <string.h>
+
+# include "delta.h"
+
+/**
+ * @brief Hashes the DELTA_BLOCK_SIZE bytes at a position.
+ */
+static uint64_t delta_hash(const uint8_t* p) {
+    uint64_t low;
+    uint64_t high;
+    memcpy(&low, p, sizeof(low));
+    memcpy(&high, p + 8, sizeof(high));
+    uint64_t hash = (low * 0x9e3779b97f4a7c15ULL) ^ high;
+
+    // mix high bits down, since table slots use the low bits
+    hash ^= hash >> 32;
+    hash *= 0xc2b2ae3d27d4eb4fULL;
+    hash ^= hash >> 29;
+    return hash;
+}
+
+/**
+ * @brief Writes an unsigned varint.
+ *
+ * @param out The output position.
+ * @param end The end of the output buffer.
+ * @param value The value to write.
+ * @return The new output position, or NULL if the output is full.
+ */
+static uint8_t* put_varint(uint8_t* out, uint8_t* end, uint64_t value) {
+    do {
+        if (out >= end) {
+            return NULL;
+        }
+        uint8_t byte = value & 0x7f;
+        value >>= 7;
+        *out++ = byte | (value != 0 ? 0x80 : 0);
+    } while (value != 0);
+    return out;
+}
+
+/**
+ * @brief Reads an unsigned varint.
+ *
+ * @param in The input position, advanced past the varint.
+ * @param end The end of the input.
+ * @param value Receives the value.
+ * @return 1 if a varint was read, 0 if the input is truncated or malformed.
+ */
+static int get_varint(const uint8_t** in, const uint8_t* end, uint64_t* value) {
+    *value = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        if (*in >= end) {
+            return 0;
+        }
+        uint8_t byte = *(*in)++;
+        *value |= (uint64_t)(byte & 0x7f) << shift;
+        if ((byte & 0x80) == 0) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief Writes an insert instruction with its literal bytes.
+ *
+ * @param out The output position.
+ * @param end The end of the output buffer.
+ * @param data The literal bytes.
+ * @param length The number of literal bytes.
+ * @return The new output position, or NULL if the output is full.
+ */
+static uint8_t* put_insert(uint8_t* out, uint8_t* end, const uint8_t* data, size_t length) {
+    if (length == 0) {
+        return out;
+    }
+    if (out >= end) {
+        return NULL;
+    }
+    *out++ = DELTA_INSERT;
+    if ((out = put_varint(out, end, length)) == NULL || (size_t)(end - out) < length) {
+        return NULL;
+    }
+    memcpy(out, data, length);
+    return out + length;
+}
+
+/**
+ * @brief Encodes a target as a delta against a base.
+ *
+ * @param base The base content.
+ * @param base_size The number of bytes in base.
+ * @param target The content to encode.
+ * @param target_size The number of bytes in target.
+ * @param out The output buffer.
+ * @param capacity The output capacity; encoding gives up when it is reached.
+ * @return The delta size, or 0 if the delta does not fit in capacity.
+ */
+size_t delta_encode(const uint8_t* base, size_t base_size, const uint8_t* target, size_t target_size, uint8_t* out, size_t capacity) {
+    if (base_size < DELTA_BLOCK_SIZE || capacity == 0) {
+        return 0;
+    }
+
+    // index base blocks, table slots hold offset + 1 and 0 when empty
+    size_t blocks = base_size / DELTA_BLOCK_SIZE;
+    size_t table_size = 64;
+    while (table_size < blocks * 2) {
+        table_size *= 2;
+    }
+    uint64_t* table = calloc(table_size, sizeof(uint64_t));
+    if (table == NULL) {
+        return 0;
+    }
+    for (size_t i = 0; i < blocks; i++) {
+        size_t slot = delta_hash(base + i * DELTA_BLOCK_SIZE) & (table_size - 1);
+        table[slot] = (uint64_t)(i * DELTA_BLOCK_SIZE) + 1;
+    }
+
+    uint8_t* cursor = out;
+    uint8_t* end = out + capacity;
+    size_t anchor = 0;
+    size_t position = 0;
+    while (cursor != NULL && position + DELTA_BLOCK_SIZE <= target_size) {
+        uint64_t entry = table[delta_hash(target + position) & (table_size - 1)];
+        size_t match = (size_t)entry - 1;
+        if (entry == 0 || memcmp(base + match, target + position, DELTA_BLOCK_SIZE) != 0) {
+            position++;
+            continue;
+        }
+
+        // extend the match forwards, then backwards over pending literals
+        size_t length = DELTA_BLOCK_SIZE;
+        while (match + length < base_size && position + length < target_size && base[match + length] == target[position + length]) {
+            length++;
+        }
+        if (length < DELTA_MIN_COPY) {
+            // a short match is usually a block repeated elsewhere in the base
+            position++;
+            continue;
+        }
+        while (position > anchor && match > 0 && base[match - 1] == target[position - 1]) {
+            position--;
+            match--;
+            length++;
+        }
+
+        cursor = put_insert(cursor, end, target + anchor, position - anchor);
+        if (cursor == NULL || cursor >= end) {
+            cursor = NULL;
+            break;
+        }
+        *cursor++ = DELTA_COPY;
+        if ((cursor = put_varint(cursor, end, match)) != NULL) {
+            cursor = put_varint(cursor, end, length);
+        }
+        position += length;
+        anchor = position;
+    }
+
+    if (cursor != NULL) {
+        cursor = put_insert(cursor, end, target + anchor, target_size - anchor);
+    }
+
+    free(table);
+    return (cursor == NULL) ? 0 : (size_t)(cursor - out);
+}
+
+/**
+ * @brief Rebuilds a target from a base and a delta.
+ *
+ * @param base The base content.
+ * @param base_size The number of bytes in base.
+ * @param delta The delta instructions.
+ * @param delta_size The number of bytes in delta.
+ * @param out The output buffer.
+ * @param out_size The expected target size.
+ * @return 1 if the target was rebuilt to exactly out_size bytes, 0 if the delta is corrupt.
+ */
+int delta_apply(const uint8_t* base, size_t base_size, const uint8_t* delta, size_t delta_size, uint8_t* out, size_t out_size) {
+    const uint8_t* in = delta;
+    const uint8_t* end = delta + delta_size;
+    size_t written = 0;
+
+    while (in < end) {
+        uint8_t op = *in++;
+        uint64_t offset = 0;
+        uint64_t length;
+        if (op == DELTA_COPY && get_varint(&in, end, &offset) == 0) {
+            return 0;
+        }
+        if (get_varint(&in, end, &length) == 0 || length > out_size - written) {
+            return 0;
+        }
+
+        if (op == DELTA_COPY) {
+            if (offset > base_size || length > base_size - offset) {
+                return 0;
+            }
+            memcpy(out + written, base + offset, (size_t)length);
+        } else if (op == DELTA_INSERT) {
+            if (length > (uint64_t)(end - in)) {
+                return 0;
+            }
+            memcpy(out + written, in, (size_t)length);
+            in += length;
+        } else {
+            return 0;
+        }
+        written += (size_t)length;
+    }
+    return (written == out_size);
+}
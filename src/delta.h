@@ -0,0 +1,20 @@
+# ifndef __DELTA_H__
+# define __DELTA_H__
+
+# include <stddef.h>
+# include <stdint.h>
+
+/// Settings
+# define DELTA_BLOCK_SIZE 16
+# define DELTA_MIN_COPY 32
+# define DELTA_MAX_CHAIN 10
+
+/// Instructions
+# define DELTA_INSERT 0
+# define DELTA_COPY 1
+
+// function prototypes
+size_t delta_encode(const uint8_t* base, size_t base_size, const uint8_t* target, size_t target_size, uint8_t* out, size_t capacity);
+int delta_apply(const uint8_t* base, size_t base_size, const uint8_t* delta, size_t delta_size, uint8_t* out, size_t out_size);
+
+# endif
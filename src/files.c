@@ -8,6 +8,7 @@
 # include <stdlib.h>
 # include <string.h>
 # include <unistd.h>
+# include <errno.h>
 # include <sys/stat.h>
 
 # include "data_structures.h"
@@ -25,6 +26,60 @@ int create_directory(const char *path) {
     return (mkdir(path, 0777) == 0);
 }
 
+/**
+ * @brief Creates the missing directories on the way to a file, like mkdir -p on its dirname.
+ *
+ * @param path The path of the file.
+ * @return 1 if every parent directory exists afterwards, 0 otherwise.
+ */
+int create_parent_directories(const char *path) {
+    char buffer[4096];
+    size_t length = strlen(path);
+    if (length >= sizeof(buffer)) {
+        return 0;
+    }
+    memcpy(buffer, path, length + 1);
+
+    // create each prefix that ends at a slash, outermost first
+    for (char *slash = strchr(buffer + 1, '/'); slash != NULL; slash = strchr(slash + 1, '/')) {
+        *slash = '\0';
+        if (mkdir(buffer, 0777) != 0 && errno != EEXIST) {
+            return 0;
+        }
+        *slash = '/';
+    }
+    return 1;
+}
+
+/**
+ * @brief Creates a uniquely named temporary file next to a file it will replace.
+ *
+ * Commands that only share the repository lock may replace the same file at
+ * once; each writes its own temporary file, and the last rename wins.
+ *
+ * @param path The path of the file to replace.
+ * @param temporary Receives the path of the temporary file.
+ * @param size The size of the temporary buffer.
+ * @return The temporary file open for writing, or NULL on failure.
+ */
+FILE *open_temporary(const char *path, char *temporary, size_t size) {
+    if ((size_t)snprintf(temporary, size, "%s.XXXXXX", path) >= size) {
+        return NULL;
+    }
+    int fd = mkstemp(temporary);
+    if (fd < 0) {
+        printf("vcs: error: could not create %s file\n", temporary);
+        return NULL;
+    }
+    fchmod(fd, 0644);
+    FILE *file = fdopen(fd, "wb");
+    if (file == NULL) {
+        close(fd);
+        remove(temporary);
+    }
+    return file;
+}
+
 /**
  * @brief Writes an empty file at the specified path.
  *
@@ -96,29 +151,60 @@ int append_to_file(const char *path, const char *content) {
  * @brief Reads the content of a file at the specified path.
  *
  * @param path The path of the file to read.
- * @return A dynamically allocated string containing the file content, or NULL if an error occurred.
+ * @param size If not NULL, receives the number of bytes read.
+ * @return A dynamically allocated, NUL-terminated buffer containing the file content, or NULL if an error occurred.
  *         The caller is responsible for freeing the allocated memory.
  */
-char *read_file(const char *path) {
-    FILE *file = open_file(path, "r");
+char *read_file(const char *path, size_t *size) {
+    FILE *file = open_file(path, "rb");
     if (file == NULL) {
         return NULL;
     }
 
     // get file size
-    fseek(file, 0, SEEK_END);
-    long file_size = ftell(file);
+    fseeko(file, 0, SEEK_END);
+    off_t file_size = ftello(file);
     rewind(file);
 
     // allocate memory for file content
-    char *content = malloc(file_size * sizeof(char));
+    char *content = malloc((file_size + 1) * sizeof(char));
     if (content == NULL) {
         printf("vcs: error: could not allocate memory for %s file\n", path);
+        fclose(file);
         return NULL;
     }
 
     // read file content
-    fread(content, sizeof(char), file_size, file);
+    size_t bytes_read = fread(content, sizeof(char), file_size, file);
+    content[bytes_read] = '\0';
     fclose(file);
+
+    if (size != NULL) {
+        *size = bytes_read;
+    }
     return content;
 }
+
+/**
+ * @brief Writes a whole buffer to a file descriptor, retrying short writes.
+ *
+ * @param fd The file descriptor to write to.
+ * @param data The data to write.
+ * @param size The number of bytes in data.
+ * @return 1 if every byte was written, 0 otherwise.
+ */
+int write_bytes(int fd, const void *data, size_t size) {
+    const char *bytes = (const char *)data;
+    while (size > 0) {
+        ssize_t written = write(fd, bytes, size);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return 0;
+        }
+        bytes += written;
+        size -= (size_t)written;
+    }
+    return 1;
+}
@@ -5,9 +5,12 @@
 
 // FUNCTIONS
 int create_directory(const char *path);
+int create_parent_directories(const char *path);
 int write_empty_file(const char *path);
 int write_file(const char *path, const char *content);
 FILE *open_file(const char *path, const char *mode);
+FILE *open_temporary(const char *path, char *temporary, size_t size);
 int append_to_file(const char *path, const char *content);
-char *read_file(const char *path);
+char *read_file(const char *path, size_t *size);
+int write_bytes(int fd, const void *data, size_t size);
 # endif
@@ -0,0 +1,543 @@
+/**
+ * @file journal.c
+ * @brief Crash safety for the VCS (Version Control System).
+ *
+ * Every file of the repository is only ever appended to, so an interrupted
+ * command can leave a torn tail behind: half a line in the blobs file, half a
+ * record in the contents file or the metadata index, or a metadata record
+ * pointing past the end of the commits file. The journal records a
+ * checksummed checkpoint after every commit, with the size each file had once
+ * the commit was written. A commit appends its text, its metadata record and
+ * its checkpoint, then flushes every file it touched in one group. Writeback
+ * of all of them starts before waiting on any, instead of one flush per file
+ * as each is closed. Since the checkpoint digest covers the commit it
+ * describes, a checkpoint whose commit did not reach the disk does not verify.
+ *
+ * Recovery runs when a command opens the repository. It drops checkpoints
+ * that do not verify, cuts the commits file and the metadata index back to
+ * the last one that does, and cuts the blobs and contents files after their
+ * last complete entry. Repositories without checkpoints get the same cuts
+ * from the structure of the files alone. Setting journal.sync to 0 keeps the
+ * checkpoints but skips the flushes.
+ */
+# define _GNU_SOURCE
+
+# include <stdio.h>
+# include <stdlib.h>
+# include <string.h>
+# include <inttypes.h>
+# include <fcntl.h>
+# include <unistd.h>
+# include <sys/file.h>
+# include <sys/mman.h>
+# include <sys/stat.h>
+
+# include "validations.h"
+# include "files.h"
+# include "config.h"
+# include "contents.h"
+# include "metadata.h"
+# include "journal.h"
+
+static int journal_fd = -1;
+static int journal_writable = 0;
+static int durable = -1;
+
+// while checking, cuts are only counted so readers can look under the shared lock
+static int journal_checking = 0;
+static int journal_cuts = 0;
+
+/**
+ * @brief Tells whether writes must reach the disk before a command reports them done.
+ *
+ * @return 1 unless journal.sync is set to 0.
+ */
+static int journal_durable() {
+    if (durable < 0) {
+        durable = (config_get(CONFIG_JOURNAL_SYNC, 1) != 0);
+    }
+    return durable;
+}
+
+/**
+ * @brief Waits until the data written to a file is on the disk.
+ *
+ * @param fd The file descriptor.
+ * @return 1 on success, 0 otherwise.
+ */
+static int journal_flush(int fd) {
+# if defined(__APPLE__)
+    // fsync only reaches the drive cache on macOS
+    return fcntl(fd, F_FULLFSYNC) == 0 || fsync(fd) == 0;
+# elif defined(__linux__)
+    return fdatasync(fd) == 0;
+# else
+    return fsync(fd) == 0;
+# endif
+}
+
+/**
+ * @brief Flushes a group of files to the disk together.
+ *
+ * Writeback of every file is started before waiting on the first one, so the
+ * disk sees the writes of the whole group at once. Files that do not exist
+ * are skipped; a directory in the group makes entries created in it durable.
+ *
+ * @param paths The paths of the files.
+ * @param count The number of paths, at most JOURNAL_MAX_FILES.
+ * @return 1 on success, 0 otherwise.
+ */
+int journal_sync(const char* const* paths, size_t count) {
+    if (!journal_durable()) {
+        return 1;
+    }
+
+    int fds[JOURNAL_MAX_FILES];
+    size_t opened = 0;
+    for (size_t i = 0; i < count && opened < JOURNAL_MAX_FILES; i++) {
+        int fd = open(paths[i], O_RDONLY);
+        if (fd >= 0) {
+            fds[opened++] = fd;
+        }
+    }
+
+# ifdef __linux__
+    for (size_t i = 0; i < opened; i++) {
+        sync_file_range(fds[i], 0, 0, SYNC_FILE_RANGE_WRITE);
+    }
+# endif
+
+    int ok = 1;
+    for (size_t i = 0; i < opened; i++) {
+        if (journal_flush(fds[i]) == 0) {
+            ok = 0;
+        }
+        close(fds[i]);
+    }
+    if (!ok) {
+        printf("vcs: error: could not flush repository files to disk\n");
+    }
+    return ok;
+}
+
+/**
+ * @brief Flushes an open file that is about to replace another one.
+ *
+ * @param file The file, written but not closed yet.
+ * @return 1 on success, 0 otherwise.
+ */
+int journal_sync_file(FILE* file) {
+    if (fflush(file) != 0) {
+        return 0;
+    }
+    return !journal_durable() || journal_flush(fileno(file));
+}
+
+/**
+ * @brief Returns the size of a file.
+ *
+ * @param path The path of the file.
+ * @return The size, or 0 if the file does not exist.
+ */
+static uint64_t journal_file_size(const char* path) {
+    struct stat st;
+    return (stat(path, &st) == 0) ? (uint64_t)st.st_size : 0;
+}
+
+/**
+ * @brief Hashes a byte range of a file into a digest.
+ *
+ * @param context The digest context.
+ * @param fd The file descriptor.
+ * @param start The first byte.
+ * @param end The byte after the last byte.
+ * @return 1 if the whole range could be read, 0 otherwise.
+ */
+static int journal_hash_range(Sha256Context* context, int fd, uint64_t start, uint64_t end) {
+    char buffer[65536];
+    while (start < end) {
+        size_t wanted = (end - start < sizeof(buffer)) ? (size_t)(end - start) : sizeof(buffer);
+        ssize_t got = pread(fd, buffer, wanted, (off_t)start);
+        if (got <= 0) {
+            return 0;
+        }
+        sha256_update(context, buffer, (size_t)got);
+        start += (uint64_t)got;
+    }
+    return 1;
+}
+
+/**
+ * @brief Computes the digest of a checkpoint from its fields and the commit it describes.
+ *
+ * @param record The checkpoint.
+ * @param digest Receives the digest.
+ * @return 1 on success, 0 if the commit is not entirely on disk.
+ */
+static int journal_digest(const JournalRecord* record, uint8_t digest[DIGEST_SIZE]) {
+    if (record->commits_end < record->commits_start || record->metadata_end < METADATA_HEADER_SIZE + sizeof(MetadataRecord)) {
+        return 0;
+    }
+
+    int commits_fd = open(COMMITS_FILE, O_RDONLY);
+    int metadata_fd = open(METADATA_FILE, O_RDONLY);
+    Sha256Context context;
+    sha256_init(&context);
+    sha256_update(&context, record, offsetof(JournalRecord, digest));
+    int ok = (commits_fd >= 0 && metadata_fd >= 0)
+             && journal_hash_range(&context, commits_fd, record->commits_start, record->commits_end)
+             && journal_hash_range(&context, metadata_fd, record->metadata_end - sizeof(MetadataRecord), record->metadata_end);
+    if (commits_fd >= 0) {
+        close(commits_fd);
+    }
+    if (metadata_fd >= 0) {
+        close(metadata_fd);
+    }
+    if (ok) {
+        sha256_final(&context, digest);
+    }
+    return ok;
+}
+
+/**
+ * @brief Records a checkpoint for the commit just written and flushes the commit to disk.
+ *
+ * The commit text must already be in the commits file and its record must
+ * be the last one of the metadata index. The contents and blobs files are
+ * part of the group, so the blobs the commit refers to are durable with it.
+ *
+ * @param commits_start The start byte of the commit in the commits file.
+ * @param commits_end The byte after the commit in the commits file.
+ * @return 1 on success, 0 otherwise.
+ */
+int journal_commit(uint64_t commits_start, uint64_t commits_end) {
+    JournalRecord record;
+    memset(&record, 0, sizeof(record));
+    memcpy(record.magic, JOURNAL_MAGIC, 4);
+    record.version = JOURNAL_VERSION;
+    record.commits_start = commits_start;
+    record.commits_end = commits_end;
+    record.metadata_end = journal_file_size(METADATA_FILE);
+    record.contents_size = journal_file_size(CONTENTS_FILE);
+    record.blobs_size = journal_file_size(BLOBS_FILE);
+    if (journal_digest(&record, record.digest) == 0) {
+        printf("vcs: error: could not read back the commit for %s\n", JOURNAL_FILE);
+        return 0;
+    }
+
+    int fd = open(JOURNAL_FILE, O_WRONLY | O_APPEND | O_CREAT, 0666);
+    if (fd < 0) {
+        printf("vcs: error: could not open %s file\n", JOURNAL_FILE);
+        return 0;
+    }
+    int written = write_bytes(fd, &record, sizeof(record));
+    if (close(fd) != 0 || !written) {
+        printf("vcs: error: could not append to %s\n", JOURNAL_FILE);
+        return 0;
+    }
+
+    // one flush for everything the commit wrote
+    const char* group[] = { CONTENTS_FILE, BLOBS_FILE, COMMITS_FILE, METADATA_FILE, JOURNAL_FILE, VCS_DIRECTORY };
+    return journal_sync(group, sizeof(group) / sizeof(group[0]));
+}
+
+/**
+ * @brief Cuts a file back to a size if it is longer.
+ *
+ * @param path The path of the file.
+ * @param size The size to keep.
+ * @return 1 if the file was cut, or would be while checking, 0 if it was not longer, -1 on error.
+ */
+static int journal_truncate(const char* path, uint64_t size) {
+    uint64_t current = journal_file_size(path);
+    if (current <= size) {
+        return 0;
+    }
+    if (journal_checking) {
+        journal_cuts++;
+        return 1;
+    }
+    if (truncate(path, (off_t)size) != 0) {
+        printf("vcs: error: could not repair %s\n", path);
+        return -1;
+    }
+    printf("vcs: warning: discarded %" PRIu64 " bytes of an interrupted write to %s\n", current - size, path);
+    return 1;
+}
+
+/**
+ * @brief Finds the last checkpoint that verifies, dropping those after it.
+ *
+ * @param last Receives the checkpoint.
+ * @return 1 if a checkpoint was found, 0 if there is none, -1 on error.
+ */
+static int journal_last(JournalRecord* last) {
+    uint64_t size = journal_file_size(JOURNAL_FILE);
+    uint64_t count = size / sizeof(JournalRecord);
+
+    int fd = open(JOURNAL_FILE, O_RDONLY);
+    if (fd < 0) {
+        return 0;
+    }
+    int found = 0;
+    while (count > 0 && !found) {
+        uint8_t digest[DIGEST_SIZE];
+        off_t offset = (off_t)((count - 1) * sizeof(JournalRecord));
+        found = pread(fd, last, sizeof(JournalRecord), offset) == (ssize_t)sizeof(JournalRecord)
+                && memcmp(last->magic, JOURNAL_MAGIC, 4) == 0 && last->version == JOURNAL_VERSION
+                && journal_digest(last, digest) && memcmp(digest, last->digest, DIGEST_SIZE) == 0;
+        if (!found) {
+            count--;
+        }
+    }
+    close(fd);
+
+    if (journal_truncate(JOURNAL_FILE, count * sizeof(JournalRecord)) < 0) {
+        return -1;
+    }
+    return found;
+}
+
+/**
+ * @brief Cuts the metadata index and the commits file back to whole commits.
+ *
+ * With a checkpoint, commits after it are dropped, since their checkpoint
+ * never reached the disk. Without one, partial metadata records and records
+ * pointing past the end of the commits file are dropped.
+ *
+ * @param last The last checkpoint, or NULL if there is none.
+ * @return 1 on success, 0 otherwise.
+ */
+static int journal_recover_history(const JournalRecord* last) {
+    uint64_t size = journal_file_size(METADATA_FILE);
+    if (size == 0) {
+        return 1;
+    }
+    if (size < METADATA_HEADER_SIZE) {
+        return journal_truncate(METADATA_FILE, 0) >= 0;
+    }
+
+    // indexes that still need converting are left to the conversion
+    int fd = open(METADATA_FILE, O_RDONLY);
+    if (fd < 0) {
+        return 0;
+    }
+    char header[METADATA_HEADER_SIZE];
+    uint32_t version = 0;
+    if (pread(fd, header, sizeof(header), 0) == (ssize_t)sizeof(header)) {
+        memcpy(&version, header + 4, sizeof(version));
+    }
+    if (memcmp(header, METADATA_MAGIC, 4) != 0 || version != METADATA_VERSION) {
+        close(fd);
+        return 1;
+    }
+
+    uint64_t metadata_end = METADATA_HEADER_SIZE + (size - METADATA_HEADER_SIZE) / sizeof(MetadataRecord) * sizeof(MetadataRecord);
+    uint64_t commits_end = journal_file_size(COMMITS_FILE);
+    if (last != NULL) {
+        metadata_end = last->metadata_end;
+        commits_end = last->commits_end;
+    } else {
+        uint64_t commits_size = commits_end;
+        while (metadata_end > METADATA_HEADER_SIZE) {
+            MetadataRecord record;
+            if (pread(fd, &record, sizeof(record), (off_t)(metadata_end - sizeof(record))) != (ssize_t)sizeof(record)) {
+                close(fd);
+                return 0;
+            }
+            if (record.length > 0 && record.offset + record.length <= commits_size) {
+                commits_end = record.offset + record.length;
+                break;
+            }
+            metadata_end -= sizeof(record);
+        }
+    }
+    close(fd);
+
+    int cut = journal_truncate(METADATA_FILE, metadata_end);
+    if (cut < 0 || journal_truncate(COMMITS_FILE, commits_end) < 0) {
+        return 0;
+    }
+
+    // the commit index may list dropped commits, and is rebuilt from the metadata index
+    if (cut > 0 && !journal_checking) {
+        remove(COMMIT_INDEX_FILE);
+    }
+    return 1;
+}
+
+/**
+ * @brief Tells whether a blob record starts at an offset and ends where expected.
+ *
+ * @param fd The contents file descriptor.
+ * @param start The offset of the record.
+ * @param size The size of the contents file.
+ * @param end Receives the offset after the record.
+ * @return 1 if a complete record is there, 0 otherwise.
+ */
+static int journal_record_at(int fd, uint64_t start, uint64_t size, uint64_t* end) {
+    RecordHeader header;
+    if (start + sizeof(header) > size || pread(fd, &header, sizeof(header), (off_t)start) != (ssize_t)sizeof(header)) {
+        return 0;
+    }
+    if (memcmp(header.magic, RECORD_MAGIC, 4) != 0 || header.stored_size > size - start - sizeof(header)) {
+        return 0;
+    }
+    *end = start + sizeof(header) + header.stored_size;
+    return 1;
+}
+
+/**
+ * @brief Cuts the blobs file after its last complete line and the contents file after its last complete record.
+ *
+ * Lines of the blobs file after the checkpoint are kept while they are whole
+ * and name a complete range of the contents file. Records after the last
+ * kept line are kept while they are complete, since blobs that were stored
+ * and then lost their line are still valid content.
+ *
+ * @param last The last checkpoint, or NULL if there is none.
+ * @return 1 on success, 0 otherwise.
+ */
+static int journal_recover_contents(const JournalRecord* last) {
+    int64_t framed_since = config_get(CONFIG_FRAMED_SINCE, INT64_MAX);
+    uint64_t contents_size = journal_file_size(CONTENTS_FILE);
+    uint64_t blobs_size = journal_file_size(BLOBS_FILE);
+    uint64_t blobs_end = (last != NULL && last->blobs_size <= blobs_size) ? last->blobs_size : 0;
+    uint64_t contents_end = (last != NULL && last->contents_size <= contents_size) ? last->contents_size : 0;
+
+    int fd = open(CONTENTS_FILE, O_RDONLY);
+    if (fd < 0) {
+        return 1;
+    }
+
+    if (blobs_size > blobs_end) {
+        int blobs_fd = open(BLOBS_FILE, O_RDONLY);
+        char* map = (blobs_fd >= 0) ? mmap(NULL, (size_t)blobs_size, PROT_READ, MAP_SHARED, blobs_fd, 0) : MAP_FAILED;
+        if (blobs_fd >= 0) {
+            close(blobs_fd);
+        }
+        if (map == MAP_FAILED) {
+            close(fd);
+            printf("vcs: error: could not map %s file\n", BLOBS_FILE);
+            return 0;
+        }
+
+        // "digest start end" lines, each naming a range of the contents file
+        while (blobs_end < blobs_size) {
+            const char* line = map + blobs_end;
+            const char* newline = memchr(line, '\n', (size_t)(blobs_size - blobs_end));
+            char buffer[DIGEST_HEX_SIZE + 64];
+            size_t length = (newline != NULL) ? (size_t)(newline - line) : 0;
+            if (newline == NULL || length >= sizeof(buffer)) {
+                break;
+            }
+            memcpy(buffer, line, length);
+            buffer[length] = '\0';
+
+            char digest[DIGEST_HEX_SIZE];
+            int64_t start_byte;
+            int64_t end_byte;
+            uint64_t record_end;
+            if (sscanf(buffer, "%64s %" SCNd64 " %" SCNd64, digest, &start_byte, &end_byte) != 3
+                || start_byte < 0 || end_byte < start_byte || (uint64_t)end_byte > contents_size) {
+                break;
+            }
+            if (start_byte >= framed_since && (journal_record_at(fd, (uint64_t)start_byte, contents_size, &record_end) == 0 || record_end != (uint64_t)end_byte)) {
+                break;
+            }
+            if ((uint64_t)end_byte > contents_end) {
+                contents_end = (uint64_t)end_byte;
+            }
+            blobs_end += length + 1;
+        }
+        munmap(map, (size_t)blobs_size);
+    }
+
+    // whole records after the last line are kept, up to the first torn one
+    if (framed_since != INT64_MAX) {
+        uint64_t end = (contents_end > (uint64_t)framed_since) ? contents_end : (uint64_t)framed_since;
+        uint64_t next;
+        while (end < contents_size && journal_record_at(fd, end, contents_size, &next)) {
+            end = next;
+        }
+        contents_end = end;
+    } else {
+        contents_end = contents_size;
+    }
+    close(fd);
+
+    return journal_truncate(BLOBS_FILE, blobs_end) >= 0 && journal_truncate(CONTENTS_FILE, contents_end) >= 0;
+}
+
+/**
+ * @brief Repairs every repository file, or only counts the cuts while checking.
+ *
+ * @return 1 on success, 0 otherwise.
+ */
+static int journal_repair() {
+    // an interrupted conversion finishes before anything is cut
+    if (file_exists(UPGRADE_FILE)) {
+        return 1;
+    }
+    JournalRecord last;
+    int found = journal_last(&last);
+    return (found >= 0)
+           && journal_recover_history(found ? &last : NULL)
+           && journal_recover_contents(found ? &last : NULL);
+}
+
+/**
+ * @brief Locks the repository for the command and repairs what an interrupted command left behind.
+ *
+ * The lock is held until the process exits: exclusively by commands that
+ * write, shared by commands that only read, so repairs never cut the tail a
+ * running command is still writing. Readers only check under the shared
+ * lock, and take the exclusive one for as long as a repair lasts when there
+ * is something to cut. A repository that cannot be written to is read
+ * without repairs.
+ *
+ * @param writing 1 for commands that write to the repository, 0 otherwise.
+ * @return 1 on success, 0 otherwise.
+ */
+int journal_recover(int writing) {
+    if (journal_fd < 0) {
+        journal_fd = open(JOURNAL_FILE, O_RDWR | O_CREAT, 0666);
+        journal_writable = (journal_fd >= 0);
+        if (journal_fd < 0 && !writing) {
+            journal_fd = open(JOURNAL_FILE, O_RDONLY);
+        }
+        if (journal_fd < 0 && writing) {
+            printf("vcs: error: could not open %s file\n", JOURNAL_FILE);
+            return 0;
+        }
+    }
+    // without a journal in a read-only repository there is no writer to wait for
+    if (journal_fd >= 0 && flock(journal_fd, writing ? LOCK_EX : LOCK_SH) != 0) {
+        printf("vcs: error: could not lock %s\n", JOURNAL_FILE);
+        return 0;
+    }
+    if (writing) {
+        return journal_repair();
+    }
+
+    journal_checking = 1;
+    journal_cuts = 0;
+    int ok = journal_repair();
+    journal_checking = 0;
+    if (!ok || journal_cuts == 0) {
+        return ok;
+    }
+    if (!journal_writable) {
+        printf("vcs: warning: %s cannot be written, so an interrupted write was not repaired\n", VCS_DIRECTORY);
+        return 1;
+    }
+
+    // the shared lock is released while waiting, so the repair checks again
+    if (flock(journal_fd, LOCK_EX) != 0) {
+        printf("vcs: error: could not lock %s\n", JOURNAL_FILE);
+        return 0;
+    }
+    ok = journal_repair();
+    flock(journal_fd, LOCK_SH);
+    return ok;
+}
@@ -0,0 +1,41 @@
+# ifndef __JOURNAL_H__
+# define __JOURNAL_H__
+
+# include <stdio.h>
+# include <stddef.h>
+# include <stdint.h>
+
+# include "sha256.h"
+
+/// Format
+# define JOURNAL_MAGIC "VCSJ"
+# define JOURNAL_VERSION 1
+# define JOURNAL_MAX_FILES 8
+
+typedef struct journal_record JournalRecord;
+
+/**
+ * One fixed-size checkpoint per commit, in commit order. Sizes are those of
+ * the repository files once the commit is written, in host byte order. The
+ * digest covers the fields before it, the commit text in the commits file
+ * and the commit's record in the metadata index, so a checkpoint is only
+ * valid once everything it describes has reached the disk.
+ */
+struct journal_record {
+    char magic[4];
+    uint32_t version;
+    uint64_t commits_start;
+    uint64_t commits_end;
+    uint64_t metadata_end;
+    uint64_t contents_size;
+    uint64_t blobs_size;
+    uint8_t digest[DIGEST_SIZE];
+};
+
+// function prototypes
+int journal_sync(const char* const* paths, size_t count);
+int journal_sync_file(FILE* file);
+int journal_commit(uint64_t commits_start, uint64_t commits_end);
+int journal_recover(int writing);
+
+# endif
@@ -0,0 +1,320 @@
+/**
+ * @file metadata.c
+ * @brief Binary commit metadata index for the VCS (Version Control System).
+ *
+ * The metadata index holds one fixed-size record per commit after an 8-byte
+ * header. Read commands map the file and index records directly instead of
+ * parsing text. Repositories that still have the older metadata.txt, or a
+ * version 1 index written with 32-bit offsets, are converted the first time
+ * the index is opened.
+ */
+# define _XOPEN_SOURCE 700
+
+# include <stdio.h>
+# include <stdlib.h>
+# include <string.h>
+# include <inttypes.h>
+# include <time.h>
+# include <fcntl.h>
+# include <unistd.h>
+# include <sys/mman.h>
+# include <sys/stat.h>
+
+# include "validations.h"
+# include "files.h"
+# include "metadata.h"
+# include "upgrade.h"
+
+/**
+ * @brief Writes the index header to an open file.
+ *
+ * @param file The file to write to.
+ * @param version The format version to record.
+ * @return 1 if the header was written successfully, 0 otherwise.
+ */
+static int metadata_write_header(FILE* file, uint32_t version) {
+    if (fwrite(METADATA_MAGIC, 1, 4, file) != 4) {
+        return 0;
+    }
+    return (fwrite(&version, sizeof(version), 1, file) == 1);
+}
+
+/**
+ * @brief Creates an empty metadata index.
+ *
+ * @param path The path of the index to create.
+ * @return 1 if the index was created successfully, 0 otherwise.
+ */
+int metadata_create(const char* path) {
+    FILE* file = fopen(path, "wb");
+    if (file == NULL) {
+        printf("vcs: error: could not create %s file\n", path);
+        return 0;
+    }
+    int written = metadata_write_header(file, METADATA_VERSION);
+    fclose(file);
+    return written;
+}
+
+/**
+ * @brief Reads the timestamp of a commit from its date line in the commits file.
+ *
+ * @param commits_file The open commits file.
+ * @param offset The start byte of the commit.
+ * @return The commit time, or 0 if the date could not be parsed.
+ */
+static int64_t legacy_commit_time(FILE* commits_file, int64_t offset) {
+    char line[256];
+    fseeko(commits_file, (off_t)offset, SEEK_SET);
+
+    // skip hash line, read date line
+    if (fgets(line, sizeof(line), commits_file) == NULL || fgets(line, sizeof(line), commits_file) == NULL) {
+        return 0;
+    }
+
+    struct tm tm;
+    memset(&tm, 0, sizeof(tm));
+    if (strptime(line, "%a %b %d %H:%M:%S %Y", &tm) == NULL) {
+        return 0;
+    }
+    tm.tm_isdst = -1;
+    return (int64_t)mktime(&tm);
+}
+
+/**
+ * @brief Converts the legacy text metadata file into a binary index.
+ *
+ * The index is written to a temporary file and renamed into place, so an
+ * interrupted conversion leaves the legacy file untouched.
+ *
+ * @return 1 if the conversion succeeded, 0 otherwise.
+ */
+static int metadata_convert_legacy() {
+    FILE* legacy_file = open_file(LEGACY_METADATA_FILE, "r");
+    if (legacy_file == NULL) {
+        return 0;
+    }
+    FILE* commits_file = open_file(COMMITS_FILE, "r");
+    if (commits_file == NULL) {
+        fclose(legacy_file);
+        return 0;
+    }
+    FILE* index_file = open_file(METADATA_FILE ".tmp", "wb");
+    if (index_file == NULL) {
+        fclose(commits_file);
+        fclose(legacy_file);
+        return 0;
+    }
+
+    // offsets in the text file may have been truncated to 32 bits
+    int ok = metadata_write_header(index_file, METADATA_VERSION_32BIT);
+    uint32_t slot = 0;
+    int64_t commit_floor = 0;
+
+    // read lines
+    char buffer[256];
+    while (ok && fgets(buffer, sizeof(buffer), legacy_file)) {
+        char hash[DIGEST_HEX_SIZE];
+        int64_t start_byte;
+        int64_t end_byte;
+        if (sscanf(buffer, "%64s %" SCNd64 " %" SCNd64, hash, &start_byte, &end_byte) != 3) {
+            continue;
+        }
+
+        MetadataRecord record;
+        memset(&record, 0, sizeof(record));
+        if (hex_to_digest(hash, record.id) == 0) {
+            printf("vcs: error: invalid commit hash %s in %s\n", hash, LEGACY_METADATA_FILE);
+            ok = 0;
+            break;
+        }
+        record.offset = (uint64_t)start_byte;
+        record.length = (uint32_t)(end_byte - start_byte + 1);
+        record.parent = (slot == 0) ? METADATA_NO_PARENT : slot - 1;
+
+        // the offset is kept as stored for the offset conversion, but the date is read at the true offset
+        commit_floor = upgrade_unwrap_offset(start_byte, commit_floor);
+        record.timestamp = legacy_commit_time(commits_file, commit_floor);
+
+        ok = (fwrite(&record, sizeof(record), 1, index_file) == 1);
+        slot++;
+    }
+
+    fclose(commits_file);
+    fclose(legacy_file);
+    if (fclose(index_file) != 0) {
+        ok = 0;
+    }
+
+    // replace legacy file with the index
+    if (ok && rename(METADATA_FILE ".tmp", METADATA_FILE) == 0) {
+        remove(LEGACY_METADATA_FILE);
+        return 1;
+    }
+    remove(METADATA_FILE ".tmp");
+    printf("vcs: error: could not convert %s\n", LEGACY_METADATA_FILE);
+    return 0;
+}
+
+/**
+ * @brief Reads the format version of the metadata index.
+ *
+ * @return The version, or METADATA_VERSION for an index that has no header yet.
+ */
+static uint32_t metadata_version() {
+    FILE* file = open_file(METADATA_FILE, "rb");
+    if (file == NULL) {
+        return 0;
+    }
+    char header[METADATA_HEADER_SIZE];
+    uint32_t version = METADATA_VERSION;
+    if (fread(header, 1, sizeof(header), file) == sizeof(header)) {
+        memcpy(&version, header + 4, sizeof(version));
+    }
+    fclose(file);
+    return version;
+}
+
+/**
+ * @brief Converts older repository formats if the repository has not been converted yet.
+ *
+ * @return 1 if the index exists or was created, 0 otherwise.
+ */
+static int metadata_ensure() {
+    // finish an interrupted offset conversion
+    if (file_exists(UPGRADE_FILE) == 1 && upgrade_resume() == 0) {
+        printf("vcs: error: could not finish converting repository to 64-bit offsets\n");
+        return 0;
+    }
+
+    if (file_exists(METADATA_FILE) == 0) {
+        if (file_exists(LEGACY_METADATA_FILE) == 0) {
+            return metadata_create(METADATA_FILE);
+        }
+        if (metadata_convert_legacy() == 0) {
+            return 0;
+        }
+    }
+
+    if (metadata_version() == METADATA_VERSION_32BIT) {
+        return upgrade_offsets();
+    }
+    return 1;
+}
+
+/**
+ * @brief Maps the metadata index into memory for reading.
+ *
+ * @return A pointer to the opened MetadataIndex, or NULL if it could not be opened or is malformed.
+ */
+MetadataIndex* metadata_open() {
+    if (metadata_ensure() == 0) {
+        return NULL;
+    }
+
+    MetadataIndex* index = (MetadataIndex*)malloc(sizeof(MetadataIndex));
+    if (index == NULL)
+        return index;
+    index->map = NULL;
+    index->map_size = 0;
+    index->records = NULL;
+    index->count = 0;
+
+    int fd = open(METADATA_FILE, O_RDONLY);
+    if (fd < 0) {
+        printf("vcs: error: could not open %s file\n", METADATA_FILE);
+        free(index);
+        return NULL;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        free(index);
+        return NULL;
+    }
+
+    // an empty or header-only index has no records to map
+    if ((size_t)st.st_size <= METADATA_HEADER_SIZE) {
+        close(fd);
+        return index;
+    }
+
+    void* map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        printf("vcs: error: could not map %s file\n", METADATA_FILE);
+        free(index);
+        return NULL;
+    }
+
+    if (memcmp(map, METADATA_MAGIC, 4) != 0) {
+        printf("vcs: error: %s is not a metadata index\n", METADATA_FILE);
+        munmap(map, (size_t)st.st_size);
+        free(index);
+        return NULL;
+    }
+
+    index->map = map;
+    index->map_size = (size_t)st.st_size;
+    index->records = (const MetadataRecord*)((const char*)map + METADATA_HEADER_SIZE);
+    index->count = (index->map_size - METADATA_HEADER_SIZE) / sizeof(MetadataRecord);
+    return index;
+}
+
+/**
+ * @brief Unmaps the metadata index and frees the memory.
+ *
+ * @param index The metadata index.
+ */
+void metadata_close(MetadataIndex* index) {
+    if (index->map != NULL) {
+        munmap(index->map, index->map_size);
+    }
+    free(index);
+}
+
+/**
+ * @brief Appends a commit record to the metadata index.
+ *
+ * The parent slot is the previous record, since history is linear.
+ *
+ * @param id The commit identifier.
+ * @param offset The start byte of the commit in the commits file.
+ * @param length The length in bytes of the commit in the commits file.
+ * @param timestamp The commit time.
+ * @return 1 if the record was appended successfully, 0 otherwise.
+ */
+int metadata_append(const uint8_t id[DIGEST_SIZE], uint64_t offset, uint32_t length, int64_t timestamp) {
+    if (metadata_ensure() == 0) {
+        return 0;
+    }
+
+    FILE* file = open_file(METADATA_FILE, "ab");
+    if (file == NULL) {
+        return 0;
+    }
+
+    // an index created empty gets its header on first append
+    fseeko(file, 0, SEEK_END);
+    off_t size = ftello(file);
+    if (size == 0 && metadata_write_header(file, METADATA_VERSION) == 0) {
+        fclose(file);
+        return 0;
+    }
+    size_t count = (size <= METADATA_HEADER_SIZE) ? 0 : ((size_t)size - METADATA_HEADER_SIZE) / sizeof(MetadataRecord);
+
+    MetadataRecord record;
+    memset(&record, 0, sizeof(record));
+    memcpy(record.id, id, DIGEST_SIZE);
+    record.offset = offset;
+    record.length = length;
+    record.parent = (count == 0) ? METADATA_NO_PARENT : (uint32_t)(count - 1);
+    record.timestamp = timestamp;
+
+    int written = (fwrite(&record, sizeof(record), 1, file) == 1);
+    if (fclose(file) != 0) {
+        written = 0;
+    }
+    return written;
+}
@@ -0,0 +1,44 @@
+# ifndef __METADATA_H__
+# define __METADATA_H__
+
+# include <stddef.h>
+# include <stdint.h>
+
+# include "sha256.h"
+
+/// Format
+# define METADATA_MAGIC "VCSM"
+# define METADATA_VERSION 2
+# define METADATA_VERSION_32BIT 1
+# define METADATA_HEADER_SIZE 8
+# define METADATA_NO_PARENT UINT32_MAX
+
+typedef struct metadata_record MetadataRecord;
+typedef struct metadata_index MetadataIndex;
+
+/**
+ * One fixed-size record per commit, in commit order. Fields are stored in
+ * host byte order.
+ */
+struct metadata_record {
+    uint8_t id[DIGEST_SIZE];
+    uint64_t offset;
+    uint32_t length;
+    uint32_t parent;
+    int64_t timestamp;
+};
+
+struct metadata_index {
+    void* map;
+    size_t map_size;
+    const MetadataRecord* records;
+    size_t count;
+};
+
+// function prototypes
+int metadata_create(const char* path);
+MetadataIndex* metadata_open();
+void metadata_close(MetadataIndex* index);
+int metadata_append(const uint8_t id[DIGEST_SIZE], uint64_t offset, uint32_t length, int64_t timestamp);
+
+# endif
@@ -0,0 +1,816 @@
+/**
+ * @file monitor.c
+ * @brief File system monitor for the VCS (Version Control System).
+ *
+ * The monitor is an optional background process that watches every
+ * directory of the working tree with inotify and remembers which paths
+ * changed. Each change is stamped with a counter that advances on every
+ * query. Clients talk to it over a Unix socket in the repository directory:
+ * a client sends the token of its last query and receives the paths changed
+ * since then, followed by an empty line, under a header with the new token.
+ * Status saves the token once the working tree has been checked, so its
+ * next run only stats the paths that changed in between.
+ *
+ * Any doubt falls back to a full scan: no monitor running, a token from an
+ * earlier monitor process, or events the kernel dropped after the token was
+ * handed out. The monitor needs inotify and is only available on Linux.
+ */
+# include <stdio.h>
+# include <stdlib.h>
+# include <string.h>
+# include <time.h>
+# include <errno.h>
+# include <unistd.h>
+# include <sys/socket.h>
+# include <sys/time.h>
+# include <sys/un.h>
+# ifdef __linux__
+# include <fcntl.h>
+# include <poll.h>
+# include <dirent.h>
+# include <signal.h>
+# include <sys/inotify.h>
+# include <sys/stat.h>
+# endif
+
+# include "validations.h"
+# include "files.h"
+# include "monitor.h"
+
+/**
+ * @brief Hashes the first bytes of a path with 64-bit FNV-1a.
+ *
+ * @param path The path.
+ * @param length The number of bytes to hash.
+ * @return The hash.
+ */
+static uint64_t monitor_hash(const char* path, size_t length) {
+    uint64_t hash = 14695981039346656037ULL;
+    for (size_t i = 0; i < length; i++) {
+        hash ^= (unsigned char)path[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+/**
+ * @brief Finds the slot of a path, or the empty slot where it would go.
+ *
+ * @param changes The changed paths.
+ * @param path The path, which does not need to be terminated after length bytes.
+ * @param length The length of the path.
+ * @return The slot position.
+ */
+static size_t monitor_slot(const MonitorChanges* changes, const char* path, size_t length) {
+    size_t mask = changes->slot_count - 1;
+    for (size_t i = (size_t)monitor_hash(path, length) & mask;; i = (i + 1) & mask) {
+        uint32_t slot = changes->slots[i];
+        if (slot == 0) {
+            return i;
+        }
+        const char* candidate = changes->paths[slot - 1];
+        if (strncmp(candidate, path, length) == 0 && candidate[length] == '\0') {
+            return i;
+        }
+    }
+}
+
+/**
+ * @brief Allocates from the arena of the changed paths, terminating the program on failure.
+ *
+ * @param changes The changed paths.
+ * @param size The number of bytes to allocate.
+ * @return The allocation.
+ */
+static void* monitor_alloc(MonitorChanges* changes, size_t size) {
+    void* pointer = arena_alloc(changes->arena, size);
+    if (pointer == NULL) {
+        printf("vcs: error: could not allocate memory for monitor\n");
+        exit(EXIT_FAILURE);
+    }
+    return pointer;
+}
+
+/**
+ * @brief Makes room for at least the given number of paths.
+ *
+ * @param changes The changed paths.
+ * @param capacity The number of paths to make room for.
+ */
+static void monitor_reserve(MonitorChanges* changes, size_t capacity) {
+    if (capacity <= changes->capacity) {
+        return;
+    }
+
+    char** paths = (char**)monitor_alloc(changes, capacity * sizeof(char*));
+    uint64_t* stamps = (uint64_t*)monitor_alloc(changes, capacity * sizeof(uint64_t));
+    if (changes->count > 0) {
+        memcpy(paths, changes->paths, changes->count * sizeof(char*));
+        memcpy(stamps, changes->stamps, changes->count * sizeof(uint64_t));
+    }
+    changes->paths = paths;
+    changes->stamps = stamps;
+    changes->capacity = capacity;
+
+    size_t slot_count = MONITOR_MIN_CAPACITY;
+    while (slot_count < capacity * 2) {
+        slot_count *= 2;
+    }
+    if (slot_count > changes->slot_count) {
+        changes->slots = (uint32_t*)monitor_alloc(changes, slot_count * sizeof(uint32_t));
+        memset(changes->slots, 0, slot_count * sizeof(uint32_t));
+        changes->slot_count = slot_count;
+        for (size_t i = 0; i < changes->count; i++) {
+            const char* path = changes->paths[i];
+            changes->slots[monitor_slot(changes, path, strlen(path))] = (uint32_t)(i + 1);
+        }
+    }
+}
+
+/**
+ * @brief Creates an empty set of changed paths.
+ *
+ * @param arena The arena that holds the set.
+ * @return A pointer to the new MonitorChanges.
+ */
+static MonitorChanges* monitor_changes_create(Arena* arena) {
+    MonitorChanges* changes = (MonitorChanges*)arena_alloc(arena, sizeof(MonitorChanges));
+    if (changes == NULL) {
+        printf("vcs: error: could not allocate memory for monitor\n");
+        exit(EXIT_FAILURE);
+    }
+    memset(changes, 0, sizeof(MonitorChanges));
+    changes->arena = arena;
+    monitor_reserve(changes, MONITOR_MIN_CAPACITY);
+    return changes;
+}
+
+/**
+ * @brief Records that a path changed.
+ *
+ * @param changes The changed paths.
+ * @param path The path.
+ * @param stamp The stamp of the change.
+ */
+static void monitor_mark(MonitorChanges* changes, const char* path, uint64_t stamp) {
+    if (changes->count == changes->capacity) {
+        monitor_reserve(changes, changes->capacity * 2);
+    }
+
+    size_t length = strlen(path);
+    size_t i = monitor_slot(changes, path, length);
+    if (changes->slots[i] == 0) {
+        char* copy = (char*)monitor_alloc(changes, length + 1);
+        memcpy(copy, path, length + 1);
+        changes->paths[changes->count] = copy;
+        changes->slots[i] = (uint32_t)(++changes->count);
+    }
+    changes->stamps[changes->slots[i] - 1] = stamp;
+}
+
+/**
+ * @brief Tells whether a path may have changed since the token of a query.
+ *
+ * A changed directory covers everything below it, since moving a directory
+ * only reports the directory itself.
+ *
+ * @param changes The changed paths.
+ * @param path The path.
+ * @return 1 if the path may have changed, 0 if it is known to be unchanged.
+ */
+int monitor_changed(const MonitorChanges* changes, const char* path) {
+    if (!changes->complete) {
+        return 1;
+    }
+    for (const char* end = path;; end++) {
+        if (*end == '/' || *end == '\0') {
+            size_t length = (size_t)(end - path);
+            if (changes->slots[monitor_slot(changes, path, length)] != 0) {
+                return 1;
+            }
+        }
+        if (*end == '\0') {
+            return 0;
+        }
+    }
+}
+
+/**
+ * @brief Connects to the monitor of the repository.
+ *
+ * @return The connected socket, or -1 if no monitor is listening.
+ */
+static int monitor_connect(void) {
+    struct sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    strncpy(address.sun_path, MONITOR_SOCKET, sizeof(address.sun_path) - 1);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+        return -1;
+    }
+    if (connect(fd, (struct sockaddr*)&address, sizeof(address)) != 0) {
+        close(fd);
+        return -1;
+    }
+
+    // a monitor that stopped answering is the same as no monitor
+    struct timeval timeout = { MONITOR_TIMEOUT_SECONDS, 0 };
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+    return fd;
+}
+
+/**
+ * @brief Asks the monitor which paths changed since the saved token.
+ *
+ * @param arena The arena of the command.
+ * @return A pointer to the changed paths, or NULL if no monitor answered.
+ */
+MonitorChanges* monitor_query(Arena* arena) {
+    int fd = monitor_connect();
+    if (fd < 0) {
+        return NULL;
+    }
+
+    // token of the last query whose paths were all looked at
+    char token[MONITOR_TOKEN_SIZE] = "none";
+    FILE* saved = fopen(MONITOR_TOKEN_FILE, "r");
+    if (saved != NULL) {
+        if (fgets(token, sizeof(token), saved) == NULL) {
+            strcpy(token, "none");
+        }
+        token[strcspn(token, "\n")] = '\0';
+        fclose(saved);
+    }
+    char request[MONITOR_TOKEN_SIZE + 16];
+    int length = snprintf(request, sizeof(request), "changes %s\n", token);
+    FILE* stream = NULL;
+    if (write_bytes(fd, request, (size_t)length) == 0 || (stream = fdopen(fd, "r")) == NULL) {
+        close(fd);
+        return NULL;
+    }
+
+    MonitorChanges* changes = monitor_changes_create(arena);
+    char* line = NULL;
+    size_t capacity = 0;
+    ssize_t length_read;
+    int ok = 0;
+    if ((length_read = getline(&line, &capacity, stream)) > 0) {
+        line[strcspn(line, "\n")] = '\0';
+        if (strncmp(line, "ok ", 3) == 0 || strncmp(line, "full ", 5) == 0) {
+            changes->complete = (line[0] == 'o');
+            snprintf(changes->token, sizeof(changes->token), "%s", strchr(line, ' ') + 1);
+
+            // the reply ends with an empty line, so a cut reply is not taken as complete
+            while ((length_read = getline(&line, &capacity, stream)) > 0) {
+                line[length_read - 1] = '\0';
+                if (line[0] == '\0') {
+                    ok = 1;
+                    break;
+                }
+                monitor_mark(changes, line, 0);
+            }
+        }
+    }
+    free(line);
+    fclose(stream);
+    return ok ? changes : NULL;
+}
+
+/**
+ * @brief Saves the token of a query whose paths have all been looked at.
+ *
+ * @param changes The changed paths returned by the query.
+ * @return 1 if the token was saved successfully, 0 otherwise.
+ */
+int monitor_save_token(const MonitorChanges* changes) {
+    // statuses running at once each write their own temporary file
+    char temporary[64];
+    FILE* file = open_temporary(MONITOR_TOKEN_FILE, temporary, sizeof(temporary));
+    if (file == NULL) {
+        return 0;
+    }
+    int ok = (fprintf(file, "%s\n", changes->token) > 0);
+    if (fclose(file) != 0) {
+        ok = 0;
+    }
+    if (ok && rename(temporary, MONITOR_TOKEN_FILE) == 0) {
+        return 1;
+    }
+    remove(temporary);
+    printf("vcs: error: could not write %s file\n", MONITOR_TOKEN_FILE);
+    return 0;
+}
+
+/**
+ * @brief Stops the monitor of the repository.
+ *
+ * @return 1 if the monitor stopped, 0 if none was running.
+ */
+int monitor_stop(void) {
+    int fd = monitor_connect();
+    if (fd < 0) {
+        printf("vcs: error: monitor is not running\n");
+        return 0;
+    }
+    char reply[4] = "";
+    int ok = write_bytes(fd, "parar\n", 6) && recv(fd, reply, 3, MSG_WAITALL) == 3 && strncmp(reply, "ok\n", 3) == 0;
+    close(fd);
+    if (!ok) {
+        printf("vcs: error: monitor did not answer\n");
+    }
+    return ok;
+}
+
+# ifdef __linux__
+
+/// Settings
+# define MONITOR_EVENTS (IN_CREATE | IN_DELETE | IN_MODIFY | IN_ATTRIB | IN_CLOSE_WRITE | IN_MOVED_FROM | IN_MOVED_TO | IN_DELETE_SELF | IN_MOVE_SELF | IN_ONLYDIR | IN_DONT_FOLLOW)
+
+typedef struct monitor_state MonitorState;
+
+/**
+ * Everything the monitor process keeps. Watches maps each watch descriptor
+ * to the directory it watches, or NULL. Links are the symbolic links found
+ * in the tree: changes below them are seen under another path, so they are
+ * reported as changed in every answer. Now is the stamp of the events read
+ * since the last query, and lost is the stamp at which events were dropped:
+ * tokens handed out before it are not accepted. A lost of UINT64_MAX means
+ * some directory could not be watched, and no token is accepted any more.
+ */
+struct monitor_state {
+    int inotify;
+    int listener;
+    int root;
+    int running;
+    char** watches;
+    size_t watch_count;
+    char** links;
+    size_t link_count;
+    size_t link_capacity;
+    MonitorChanges* changes;
+    uint64_t now;
+    uint64_t lost;
+    char generation[MONITOR_TOKEN_SIZE / 2];
+};
+
+/**
+ * @brief Stops accepting the tokens handed out so far.
+ *
+ * @param state The monitor state.
+ */
+static void monitor_lose(MonitorState* state) {
+    if (state->lost < state->now) {
+        state->lost = state->now;
+    }
+}
+
+/**
+ * @brief Joins a directory and an entry name, leaving out the working tree root.
+ *
+ * @param directory The directory path.
+ * @param name The entry name.
+ * @return The joined path, which the caller frees, or NULL on allocation failure.
+ */
+static char* monitor_join(const char* directory, const char* name) {
+    size_t directory_length = (strcmp(directory, ".") == 0) ? 0 : strlen(directory);
+    size_t name_length = strlen(name);
+    char* path = malloc(directory_length + name_length + 2);
+    if (path == NULL) {
+        return NULL;
+    }
+    if (directory_length > 0) {
+        memcpy(path, directory, directory_length);
+        path[directory_length++] = '/';
+    }
+    memcpy(path + directory_length, name, name_length + 1);
+    return path;
+}
+
+/**
+ * @brief Remembers a symbolic link, whose target is not watched.
+ *
+ * @param state The monitor state.
+ * @param path The path of the link.
+ * @return 1 on success, 0 on allocation failure.
+ */
+static int monitor_link(MonitorState* state, const char* path) {
+    if (state->link_count == state->link_capacity) {
+        size_t capacity = (state->link_capacity == 0) ? MONITOR_MIN_CAPACITY : state->link_capacity * 2;
+        char** links = realloc(state->links, capacity * sizeof(char*));
+        if (links == NULL) {
+            return 0;
+        }
+        state->links = links;
+        state->link_capacity = capacity;
+    }
+    state->links[state->link_count] = strdup(path);
+    return state->links[state->link_count++] != NULL;
+}
+
+/**
+ * @brief Watches a directory and every directory below it.
+ *
+ * @param state The monitor state.
+ * @param directory The directory path.
+ * @param mark 1 to record everything found as changed, for directories that appeared.
+ * @return 1 on success, 0 if a directory could not be watched.
+ */
+static int monitor_watch(MonitorState* state, const char* directory, int mark) {
+    int wd = inotify_add_watch(state->inotify, directory, MONITOR_EVENTS);
+    if (wd < 0) {
+        // a directory that is already gone reports its removal on its own
+        return errno == ENOENT || errno == ENOTDIR;
+    }
+    if ((size_t)wd >= state->watch_count) {
+        size_t watch_count = (state->watch_count == 0) ? MONITOR_MIN_CAPACITY : state->watch_count;
+        while (watch_count <= (size_t)wd) {
+            watch_count *= 2;
+        }
+        char** watches = realloc(state->watches, watch_count * sizeof(char*));
+        if (watches == NULL) {
+            return 0;
+        }
+        memset(watches + state->watch_count, 0, (watch_count - state->watch_count) * sizeof(char*));
+        state->watches = watches;
+        state->watch_count = watch_count;
+    }
+    char* copy = strdup(directory);
+    if (copy == NULL) {
+        return 0;
+    }
+    free(state->watches[wd]);
+    state->watches[wd] = copy;
+
+    DIR* stream = opendir(directory);
+    if (stream == NULL) {
+        return 1;
+    }
+    int ok = 1;
+    struct dirent* entry;
+    while (ok && (entry = readdir(stream)) != NULL) {
+        const char* name = entry->d_name;
+        if (strcmp(name, ".") == 0 || strcmp(name, "..") == 0 || strcmp(name, VCS_DIRECTORY) == 0) {
+            continue;
+        }
+        unsigned char type = entry->d_type;
+        if (type == DT_UNKNOWN) {
+            struct stat st;
+            type = DT_REG;
+            if (fstatat(dirfd(stream), name, &st, AT_SYMLINK_NOFOLLOW) == 0) {
+                type = S_ISDIR(st.st_mode) ? DT_DIR : (S_ISLNK(st.st_mode) ? DT_LNK : DT_REG);
+            }
+        }
+        if (!mark && type != DT_DIR && type != DT_LNK) {
+            continue;
+        }
+
+        char* path = monitor_join(directory, name);
+        if (path == NULL) {
+            ok = 0;
+            break;
+        }
+        if (mark) {
+            monitor_mark(state->changes, path, state->now);
+        }
+        if (type == DT_DIR) {
+            ok = monitor_watch(state, path, mark);
+        } else if (type == DT_LNK) {
+            ok = monitor_link(state, path);
+        }
+        free(path);
+    }
+    closedir(stream);
+    return ok;
+}
+
+/**
+ * @brief Stops watching a directory that moved away and every directory below it.
+ *
+ * @param state The monitor state.
+ * @param directory The old directory path.
+ */
+static void monitor_unwatch(MonitorState* state, const char* directory) {
+    size_t length = strlen(directory);
+    for (size_t wd = 0; wd < state->watch_count; wd++) {
+        const char* watched = state->watches[wd];
+        if (watched != NULL && strncmp(watched, directory, length) == 0 && (watched[length] == '\0' || watched[length] == '/')) {
+            inotify_rm_watch(state->inotify, (int)wd);
+            free(state->watches[wd]);
+            state->watches[wd] = NULL;
+        }
+    }
+}
+
+/**
+ * @brief Records the path one inotify event is about.
+ *
+ * @param state The monitor state.
+ * @param event The event.
+ */
+static void monitor_event(MonitorState* state, const struct inotify_event* event) {
+    if (event->mask & IN_Q_OVERFLOW) {
+        monitor_lose(state);
+        return;
+    }
+    if (event->wd < 0 || (size_t)event->wd >= state->watch_count || state->watches[event->wd] == NULL) {
+        return;
+    }
+    const char* directory = state->watches[event->wd];
+    if (event->mask & IN_IGNORED) {
+        free(state->watches[event->wd]);
+        state->watches[event->wd] = NULL;
+        return;
+    }
+    if (event->mask & (IN_DELETE_SELF | IN_MOVE_SELF)) {
+        // without its root there is no working tree to watch
+        if (event->wd == state->root) {
+            state->running = 0;
+        }
+        return;
+    }
+    if (event->len == 0 || (event->wd == state->root && strcmp(event->name, VCS_DIRECTORY) == 0)) {
+        return;
+    }
+
+    // a name that cannot travel on its own line is reported through its directory
+    if (strchr(event->name, '\n') != NULL) {
+        if (event->wd == state->root) {
+            monitor_lose(state);
+        } else {
+            monitor_mark(state->changes, directory, state->now);
+        }
+        return;
+    }
+
+    char* path = monitor_join(directory, event->name);
+    if (path == NULL) {
+        monitor_lose(state);
+        return;
+    }
+    monitor_mark(state->changes, path, state->now);
+    struct stat st;
+    if ((event->mask & (IN_CREATE | IN_MOVED_TO)) && lstat(path, &st) == 0 && S_ISLNK(st.st_mode) && monitor_link(state, path) == 0) {
+        monitor_lose(state);
+    }
+    if (event->mask & IN_ISDIR) {
+        if (event->mask & IN_MOVED_FROM) {
+            monitor_unwatch(state, path);
+        }
+        if ((event->mask & (IN_CREATE | IN_MOVED_TO)) && monitor_watch(state, path, 1) == 0) {
+            state->lost = UINT64_MAX;
+        }
+    }
+    free(path);
+}
+
+/**
+ * @brief Reads every pending inotify event.
+ *
+ * @param state The monitor state.
+ */
+static void monitor_read_events(MonitorState* state) {
+    char buffer[MONITOR_EVENT_BUFFER] __attribute__((aligned(__alignof__(struct inotify_event))));
+    ssize_t size;
+    while ((size = read(state->inotify, buffer, sizeof(buffer))) > 0) {
+        for (char* cursor = buffer; cursor < buffer + size;) {
+            const struct inotify_event* event = (const struct inotify_event*)cursor;
+            monitor_event(state, event);
+            cursor += sizeof(struct inotify_event) + event->len;
+        }
+    }
+
+    // past the limit the paths are forgotten, and older tokens with them
+    if (state->changes->count > MONITOR_MAX_PATHS) {
+        Arena* arena = state->changes->arena;
+        arena_destroy(arena);
+        arena = arena_create();
+        state->changes = monitor_changes_create(arena);
+        monitor_lose(state);
+    }
+}
+
+/**
+ * @brief Answers one client.
+ *
+ * @param state The monitor state.
+ * @param client The connected client socket, which this function closes.
+ */
+static void monitor_answer(MonitorState* state, int client) {
+    struct timeval timeout = { MONITOR_TIMEOUT_SECONDS, 0 };
+    setsockopt(client, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    setsockopt(client, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+
+    char request[MONITOR_TOKEN_SIZE + 16];
+    size_t length = 0;
+    while (length < sizeof(request) - 1) {
+        ssize_t received = recv(client, request + length, sizeof(request) - 1 - length, 0);
+        if (received <= 0) {
+            break;
+        }
+        length += (size_t)received;
+        if (memchr(request, '\n', length) != NULL) {
+            break;
+        }
+    }
+    request[length] = '\0';
+    if (strchr(request, '\n') == NULL) {
+        close(client);
+        return;
+    }
+    request[strcspn(request, "\n")] = '\0';
+
+    FILE* stream = fdopen(client, "w");
+    if (stream == NULL) {
+        close(client);
+        return;
+    }
+    if (strcmp(request, "parar") == 0) {
+        fprintf(stream, "ok\n");
+        fclose(stream);
+        state->running = 0;
+        return;
+    }
+
+    // every change made before the query must be in the answer
+    monitor_read_events(state);
+
+    char generation[MONITOR_TOKEN_SIZE];
+    unsigned long long since = 0;
+    int accepted = (sscanf(request, "changes %63[^:]:%llu", generation, &since) == 2);
+    accepted = accepted && strcmp(generation, state->generation) == 0 && since < state->now && state->lost <= since;
+
+    fprintf(stream, "%s %s:%llu\n", accepted ? "ok" : "full", state->generation, (unsigned long long)state->now);
+    for (size_t i = 0; accepted && i < state->changes->count; i++) {
+        if (state->changes->stamps[i] > since) {
+            fprintf(stream, "%s\n", state->changes->paths[i]);
+        }
+    }
+    for (size_t i = 0; accepted && i < state->link_count; i++) {
+        fprintf(stream, "%s\n", state->links[i]);
+    }
+    fprintf(stream, "\n");
+    fclose(stream);
+
+    // events from now on come after the token just handed out
+    state->now++;
+}
+
+/**
+ * @brief Serves queries and records events until the monitor is stopped.
+ *
+ * @param state The monitor state.
+ */
+static void monitor_serve(MonitorState* state) {
+    while (state->running) {
+        struct pollfd fds[2] = { { state->inotify, POLLIN, 0 }, { state->listener, POLLIN, 0 } };
+        if (poll(fds, 2, -1) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            break;
+        }
+        if (fds[0].revents & POLLIN) {
+            monitor_read_events(state);
+        }
+        if (fds[1].revents & POLLIN) {
+            int client = accept(state->listener, NULL, NULL);
+            if (client >= 0) {
+                monitor_answer(state, client);
+            }
+        }
+    }
+}
+
+/**
+ * @brief Releases everything the monitor state holds.
+ *
+ * @param state The monitor state.
+ */
+static void monitor_free(MonitorState* state) {
+    if (state->inotify >= 0) {
+        close(state->inotify);
+    }
+    if (state->listener >= 0) {
+        close(state->listener);
+    }
+    for (size_t wd = 0; wd < state->watch_count; wd++) {
+        free(state->watches[wd]);
+    }
+    for (size_t i = 0; i < state->link_count; i++) {
+        free(state->links[i]);
+    }
+    free(state->watches);
+    free(state->links);
+    arena_destroy(state->changes->arena);
+}
+
+/**
+ * @brief Watches the working tree and listens on the monitor socket.
+ *
+ * @param state The empty monitor state.
+ * @return 1 on success, 0 otherwise.
+ */
+static int monitor_setup(MonitorState* state) {
+    state->running = 1;
+    state->now = 1;
+    state->inotify = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (state->inotify < 0) {
+        printf("vcs: error: could not start inotify\n");
+        return 0;
+    }
+    if (monitor_watch(state, ".", 0) == 0) {
+        printf("vcs: error: could not watch every directory, try raising fs.inotify.max_user_watches\n");
+        return 0;
+    }
+    for (size_t wd = 0; wd < state->watch_count; wd++) {
+        if (state->watches[wd] != NULL && strcmp(state->watches[wd], ".") == 0) {
+            state->root = (int)wd;
+        }
+    }
+
+    struct sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    strncpy(address.sun_path, MONITOR_SOCKET, sizeof(address.sun_path) - 1);
+    state->listener = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (state->listener < 0 || bind(state->listener, (struct sockaddr*)&address, sizeof(address)) != 0 || listen(state->listener, MONITOR_BACKLOG) != 0) {
+        printf("vcs: error: could not listen on %s\n", MONITOR_SOCKET);
+        return 0;
+    }
+    return 1;
+}
+
+/**
+ * @brief Starts a monitor for the working tree in the background.
+ *
+ * The working tree is watched before the process detaches, so errors are
+ * reported to the caller and no change after this returns is missed.
+ *
+ * @return 1 if the monitor started, 0 otherwise.
+ */
+int monitor_start(void) {
+    // one monitor per repository
+    int running = monitor_connect();
+    if (running >= 0) {
+        close(running);
+        printf("vcs: error: monitor is already running\n");
+        return 0;
+    }
+    remove(MONITOR_SOCKET);
+
+    MonitorState state;
+    memset(&state, 0, sizeof(state));
+    state.inotify = -1;
+    state.listener = -1;
+    state.changes = monitor_changes_create(arena_create());
+    int ok = monitor_setup(&state);
+    fflush(stdout);
+    pid_t pid = ok ? fork() : -1;
+    if (pid != 0) {
+        monitor_free(&state);
+        if (pid > 0) {
+            printf("vcs: monitor started with pid %ld\n", (long)pid);
+            return 1;
+        }
+        if (ok) {
+            printf("vcs: error: could not start monitor process\n");
+        }
+        remove(MONITOR_SOCKET);
+        return 0;
+    }
+
+    // detach from the terminal of the command that started it
+    setsid();
+    signal(SIGPIPE, SIG_IGN);
+    int null = open("/dev/null", O_RDWR);
+    if (null >= 0) {
+        dup2(null, STDIN_FILENO);
+        dup2(null, STDOUT_FILENO);
+        dup2(null, STDERR_FILENO);
+        close(null);
+    }
+    snprintf(state.generation, sizeof(state.generation), "%ld-%ld", (long)getpid(), (long)time(NULL));
+
+    monitor_serve(&state);
+
+    remove(MONITOR_SOCKET);
+    monitor_free(&state);
+    exit(EXIT_SUCCESS);
+}
+
+# else
+
+/**
+ * @brief Reports that the monitor is not available without inotify.
+ *
+ * @return 0.
+ */
+int monitor_start(void) {
+    printf("vcs: error: the monitor needs inotify, which this system does not have\n");
+    return 0;
+}
+
+# endif
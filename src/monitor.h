@@ -0,0 +1,45 @@
+# ifndef __MONITOR_H__
+# define __MONITOR_H__
+
+# include <stddef.h>
+# include <stdint.h>
+
+# include "arena.h"
+
+/// Settings
+# define MONITOR_TOKEN_SIZE 64
+# define MONITOR_TIMEOUT_SECONDS 2
+# define MONITOR_BACKLOG 16
+# define MONITOR_MIN_CAPACITY 64
+# define MONITOR_MAX_PATHS 1048576
+# define MONITOR_EVENT_BUFFER 65536
+
+typedef struct monitor_changes MonitorChanges;
+
+/**
+ * Paths that changed, with an open-addressing hash set over them like the
+ * stage. In the monitor every path carries the stamp of its last change; a
+ * client only receives the paths changed since its token, and the token to
+ * save once it has looked at them. A client whose token was not accepted
+ * gets no paths and complete set to 0, and must look at every path.
+ */
+struct monitor_changes {
+    char token[MONITOR_TOKEN_SIZE];
+    int complete;
+    size_t count;
+    size_t capacity;
+    char** paths;
+    uint64_t* stamps;
+    uint32_t* slots;
+    size_t slot_count;
+    Arena* arena;
+};
+
+// function prototypes
+int monitor_start(void);
+int monitor_stop(void);
+MonitorChanges* monitor_query(Arena* arena);
+int monitor_changed(const MonitorChanges* changes, const char* path);
+int monitor_save_token(const MonitorChanges* changes);
+
+# endif
@@ -8,298 +8,431 @@
 # include <stdlib.h>
 # include <string.h>
 # include <ctype.h>
+# include <time.h>
+# include <inttypes.h>
+# include <fcntl.h>
+# include <unistd.h>
+# include <sys/mman.h>
+# include <sys/stat.h>
 
 # include "validations.h"
 # include "files.h"
 # include "parser.h"
 # include "utils.h"
 # include "data_structures.h"
+# include "blobs.h"
+# include "sha256.h"
+# include "metadata.h"
+# include "commit_index.h"
+# include "contents.h"
+# include "tokenizer.h"
+# include "stage.h"
+# include "snapshot.h"
+# include "journal.h"
 
 /**
- * @brief Parses the stage file and populates the file head with the parsed data.
+ * @brief Populates the file table with the staged files.
  *
- * @param head The pointer to the file head.
+ * Staged files were stored when they were added, so only their blobs are
+ * recorded. Paths staged before adds stored content are stored now.
+ *
+ * @param stage The pointer to the stage.
+ * @param files The pointer to the file table.
  */
-void parse_stage(FileHead *head) {
-    FILE* stage_file = open_file(STAGE_FILE, "r");
+void parse_stage(const Stage *stage, FileTable *files) {
+    Snapshot *snapshot = NULL;
+
+    // staged paths, in the order they were added
+    for (size_t i = 0; i < stage->count; i++) {
+        const char *path = stage->paths[i];
+        char digest[DIGEST_HEX_SIZE];
+        int64_t start_byte = stage->start_bytes[i];
+        int64_t end_byte = stage->end_bytes[i];
+
+        if (start_byte >= 0) {
+            digest_to_hex(stage->digests[i], digest);
+        } else {
+            // store file contents now
+            if (snapshot == NULL) {
+                snapshot = snapshot_open(files->arena);
+            }
+            Blob *blob = snapshot_file(snapshot, path);
+            if (blob == NULL) {
+                printf("vcs: error: could not store %s\n", path);
+                exit(EXIT_FAILURE);
+            }
+            strcpy(digest, blob->digest);
+            start_byte = blob->start_byte;
+            end_byte = blob->end_byte;
+        }
 
-    // buffer for reading lines
-    char buffer[256];
+        // store file path, digest, byte start and end in the file table
+        file_table_append(files, path, digest, start_byte, end_byte);
+    }
 
-    // read lines
-    while (fgets(buffer, sizeof(buffer), stage_file)) {
-        // remove newline character
-        buffer[strcspn(buffer, "\n")] = 0; 
-        
-        // read file path contents
-        char *content = read_file(buffer);
+    if (snapshot != NULL) {
+        snapshot_close(snapshot);
+    }
+}
 
-        // append to contents file
-        FILE* contents_file = open_file(CONTENTS_FILE, "a");
-        int start_byte = ftell(contents_file);
-        fprintf(contents_file, "%s\n", content);
-        int end_byte = ftell(contents_file) - 1;
-        fclose(contents_file);
+/**
+ * @brief Reads the identifier of the most recent commit.
+ *
+ * The last metadata record gives the offset of the commit, and its first line
+ * holds the identifier, so the cost does not grow with history.
+ *
+ * @param parent The output buffer, set to an empty string when there are no commits.
+ * @param size The size of the output buffer.
+ */
+static void read_last_commit_hash(char *parent, size_t size) {
+    parent[0] = '\0';
 
-        // store file path, byte start and end in Files linked list
-        file_insert(head, buffer, start_byte, end_byte);
+    MetadataIndex* metadata = metadata_open();
+    if (metadata == NULL) {
+        exit(EXIT_FAILURE);
+    }
+    if (metadata->count == 0) {
+        metadata_close(metadata);
+        return;
     }
+    uint64_t offset = metadata->records[metadata->count - 1].offset;
+    metadata_close(metadata);
 
-    fclose(stage_file);
+    // read the hash line of the last commit
+    FILE* commits_file = open_file(COMMITS_FILE, "r");
+    if (commits_file == NULL) {
+        exit(EXIT_FAILURE);
+    }
+    fseeko(commits_file, (off_t)offset, SEEK_SET);
+    if (fgets(parent, (int)size, commits_file) == NULL) {
+        parent[0] = '\0';
+    }
+    parent[strcspn(parent, "\n")] = '\0';
+    fclose(commits_file);
 }
 
 /**
  * @brief Parses the commit file, appends the commit to the commits file, and updates metadata.
  *
- * @param commit_head The pointer to the commit head.
- * @param file_head The pointer to the file head.
+ * @param table The pointer to the commit table.
+ * @param files The pointer to the file table of the commit.
  * @param message The commit message.
  */
-void parse_commit_file(CommitHead *commit_head, FileHead *file_head, const char *message) {
+void parse_commit_file(CommitTable *table, const FileTable *files, const char *message) {
+    // compute commit identifier from parent, date, manifest and message
+    char parent[DIGEST_HEX_SIZE];
+    read_last_commit_hash(parent, sizeof(parent));
+    time_t now = time(NULL);
+    char *date = timestamp(now);
+    char *hash = commit_hash(parent[0] != '\0' ? parent : NULL, date, files, message);
+
     // open commit file for appending
     FILE* commit_file = open_file(COMMITS_FILE, "a");
 
     // get start byte
-    int start_byte = ftell(commit_file);
+    int64_t start_byte = (int64_t)ftello(commit_file);
     // append commit to file
-    fprintf(commit_file, "%s\n", hash());
-    fprintf(commit_file, "%s\n", timestamp());
-    File* current = file_head->first;
-    while (current != NULL) {
-        fprintf(commit_file, "%s %d %d", current->path, current->start_byte, current->end_byte);
-        if (current->next != NULL) {
+    fprintf(commit_file, "%s\n", hash);
+    fprintf(commit_file, "%s\n", date);
+    for (size_t i = 0; i < files->count; i++) {
+        // paths are escaped so spaces and commas survive the list separators
+        tokenizer_write_path(commit_file, files->paths[i]);
+        fprintf(commit_file, " %s %" PRId64 " %" PRId64, files->digests[i], files->start_bytes[i], files->end_bytes[i]);
+        if (i + 1 < files->count) {
             fprintf(commit_file, ", ");
         }
-        current = current->next;
     }
-    // remove last comma
     
     fprintf(commit_file, "\n");
     fprintf(commit_file, "%s\n", message);
     
     // get end byte
-    int end_byte = ftell(commit_file) - 1;
+    int64_t end_byte = (int64_t)ftello(commit_file) - 1;
 
     // close commit file
-    fclose(commit_file);
+    if (fclose(commit_file) != 0) {
+        printf("vcs: error: could not append to %s\n", COMMITS_FILE);
+        exit(EXIT_FAILURE);
+    }
 
-    // insert commit to commit linked list
-    commit_insert(commit_head, hash(), timestamp(), message, start_byte, end_byte);
-    
-    // append to metadata file
-    FILE* metadata_file = open_file(METADATA_FILE, "a");
-    fprintf(metadata_file, "%s %d %d\n", commit_head->first->hash, start_byte, end_byte);
-    fclose(metadata_file);
+    // append commit and its files to the commit table
+    uint8_t id[DIGEST_SIZE];
+    hex_to_digest(hash, id);
+    size_t file_start = table->files.count;
+    for (size_t i = 0; i < files->count; i++) {
+        file_table_append(&table->files, files->paths[i], files->digests[i], files->start_bytes[i], files->end_bytes[i]);
+    }
+    commit_table_append(table, id, hash, date, message, (int64_t)now, start_byte, end_byte, file_start, files->count);
+    free(hash);
+
+    // append to metadata index
+    if (metadata_append(id, (uint64_t)start_byte, (uint32_t)(end_byte - start_byte + 1), (int64_t)now) == 0) {
+        printf("vcs: error: could not append to %s\n", METADATA_FILE);
+        exit(EXIT_FAILURE);
+    }
+
+    // checkpoint the commit and flush everything it wrote at once
+    if (journal_commit((uint64_t)start_byte, (uint64_t)end_byte + 1) == 0) {
+        exit(EXIT_FAILURE);
+    }
+
+    // keep the sorted commit index close to the metadata index
+    MetadataIndex* metadata = metadata_open();
+    if (metadata == NULL || commit_index_update(metadata) == 0) {
+        printf("vcs: warning: could not update %s\n", COMMIT_INDEX_FILE);
+    }
+    if (metadata != NULL) {
+        metadata_close(metadata);
+    }
 }
 
 /**
- * @brief Parses the commits metadata file and populates the commit and file heads with the parsed data.
+ * @brief Maps the commits file for in-place parsing, unless the commit table already has it mapped.
+ *
+ * The mapping is private and writable, so line ends can be replaced with
+ * terminators in place; only the pages that are parsed are read and copied.
  *
- * @param commit_head The pointer to the commit head.
+ * @param table The pointer to the commit table that owns the mapping.
+ * @return 1 if the mapping is available, 0 otherwise.
  */
-void parse_commits(CommitHead *commit_head) {
-    // read metadata file
-    FILE* metadata_file = open_file(METADATA_FILE, "r");
-
-    // buffer for reading lines
-    char buffer[256];
-
-    // read lines
-    while (fgets(buffer, sizeof(buffer), metadata_file)) {
-        // remove newline character
-        buffer[strcspn(buffer, "\n")] = 0; 
-        
-        // split line by space
-        char *hash = strtok(buffer, " ");
-        char *start_byte_str = strtok(NULL, " ");
-        char *end_byte_str = strtok(NULL, " ");
-
-        // convert start and end byte strings to integers
-        int start_byte = atoi(start_byte_str);
-        int end_byte = atoi(end_byte_str);
-
-        // open commits file
-        FILE* commits_file = open_file(COMMITS_FILE, "r");
-
-        // move file pointer to start byte
-        fseek(commits_file, start_byte, SEEK_SET);
-
-        // read hash
-        char hash_buffer[256];  // buffer for reading hash
-        fgets(hash_buffer, sizeof(hash_buffer), commits_file);  // read hash
-        hash_buffer[strcspn(hash_buffer, "\n")] = 0;  // remove newline character
-
-        // read date
-        char date_buffer[256];
-        fgets(date_buffer, sizeof(date_buffer), commits_file);
-        date_buffer[strcspn(date_buffer, "\n")] = 0;
-
-        // read files path, start byte, and end byte
-        char files_buffer[256];
-        fgets(files_buffer, sizeof(files_buffer), commits_file);
-        files_buffer[strcspn(files_buffer, "\n")] = 0;
-
-        // read message
-        char message_buffer[256];
-        fgets(message_buffer, sizeof(message_buffer), commits_file);
-        message_buffer[strcspn(message_buffer, "\n")] = 0;
-
-        // close commits file
-        fclose(commits_file);
-
-        // create file head
-        FileHead *file_head = file_create();
-
-        // process files_buffer
-        char *file_start = files_buffer;
-        char *file_end = strchr(files_buffer, ',');
-        while (file_end != NULL) {
-            // calculate the length of the file path
-            size_t path_length = file_end - file_start;
-            // allocate memory for the file path
-            char *file_path = malloc(path_length + 1);
-            // copy the file path
-            strncpy(file_path, file_start, path_length);
-            file_path[path_length] = '\0';
-
-            // move the file_start pointer to the next file
-            file_start = file_end + 1;
-            // find the next file_end pointer
-            file_end = strchr(file_start, ',');
-
-            // split the file information by space
-            char *file_info = strtok(file_path, " ");
-            char *start_byte_token = strtok(NULL, " ");
-            char *end_byte_token = strtok(NULL, " ");
-
-            // convert start and end byte strings to integers
-            int file_start_byte = atoi(start_byte_token);
-            int file_end_byte = atoi(end_byte_token);
-
-            // insert file to file linked list
-            file_insert(file_head, file_info, file_start_byte, file_end_byte);
-
-            // free dynamically allocated memory
-            free(file_path);
-        }
+static int map_commits(CommitTable *table) {
+    if (table->map != NULL) {
+        return 1;
+    }
 
-        // process the last file in files_buffer
-        size_t path_length = strlen(file_start);
-        char *file_path = malloc(path_length + 1);
-        strcpy(file_path, file_start);
+    int fd = open(COMMITS_FILE, O_RDONLY);
+    if (fd < 0) {
+        printf("vcs: error: could not open %s file\n", COMMITS_FILE);
+        return 0;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0) {
+        close(fd);
+        return 0;
+    }
 
-        // split the file information by space
-        char *file_info = strtok(file_path, " ");
-        char *start_byte_token = strtok(NULL, " ");
-        char *end_byte_token = strtok(NULL, " ");
+    void* map = mmap(NULL, (size_t)st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        printf("vcs: error: could not map %s file\n", COMMITS_FILE);
+        return 0;
+    }
+    table->map = (char*)map;
+    table->map_size = (size_t)st.st_size;
+    // files parsed from the mapping point into it as well
+    table->files.borrowed = 1;
+    return 1;
+}
 
-        // convert start and end byte strings to integers
-        int file_start_byte = atoi(start_byte_token);
-        int file_end_byte = atoi(end_byte_token);
+/**
+ * @brief Terminates the line at the cursor in place and moves the cursor past it.
+ *
+ * @param cursor The current position in the record.
+ * @param end The end of the record.
+ * @return The line, or NULL if no newline is left in the record.
+ */
+static char *next_line(char **cursor, char *end) {
+    char *line = *cursor;
+    char *newline = memchr(line, '\n', (size_t)(end - line));
+    if (newline == NULL) {
+        return NULL;
+    }
+    *newline = '\0';
+    *cursor = newline + 1;
+    return line;
+}
 
-        // insert file to file linked list
-        file_insert(file_head, file_info, file_start_byte, file_end_byte);
+/**
+ * @brief Parses the commit of a metadata record and appends it to the commit table.
+ *
+ * The record is parsed in place in the commit table's mapping of the commits
+ * file, which is created on first use and shared by every record parsed into
+ * the same table. The identifier and time come from the metadata record.
+ *
+ * @param table The pointer to the commit table.
+ * @param record The metadata record of the commit.
+ */
+void parse_commit_record(CommitTable *table, const MetadataRecord *record) {
+    uint64_t offset = record->offset;
+    uint32_t length = record->length;
+    int64_t start_byte = (int64_t)offset;
+    int64_t end_byte = (int64_t)(offset + length - 1);
+
+    if (map_commits(table) == 0) {
+        exit(EXIT_FAILURE);
+    }
+    if (length == 0 || offset + length > table->map_size) {
+        printf("vcs: error: commit at byte %" PRId64 " is outside %s\n", start_byte, COMMITS_FILE);
+        exit(EXIT_FAILURE);
+    }
 
-        // insert commit to commit linked list
-        commit_insert(commit_head, hash_buffer, date_buffer, message_buffer, start_byte, end_byte);
-        // assign file head to latest commit
-        commit_head->last->file_head = file_head;
+    // hash, date and files lines, then the message up to the final newline
+    char *cursor = table->map + offset;
+    char *end = cursor + length;
+    char *hash = next_line(&cursor, end);
+    char *date = (hash != NULL) ? next_line(&cursor, end) : NULL;
+    char *files = (date != NULL) ? next_line(&cursor, end) : NULL;
+    if (files == NULL || end[-1] != '\n') {
+        printf("vcs: error: malformed commit at byte %" PRId64 " of %s\n", start_byte, COMMITS_FILE);
+        exit(EXIT_FAILURE);
+    }
+    char *message = cursor;
+    end[-1] = '\0';
+
+    // file entries are split in one pass over the line, which ends before the message
+    size_t file_start = table->files.count;
+    Tokenizer tokenizer;
+    tokenizer_init(&tokenizer, files, (size_t)(message - files - 1));
+    FileEntry entry;
+    int parsed;
+    while ((parsed = tokenizer_next_entry(&tokenizer, &entry)) == 1) {
+        file_table_append(&table->files, entry.path, entry.digest, entry.start_byte, entry.end_byte);
     }
-    fclose(metadata_file);
+    if (parsed < 0) {
+        printf("vcs: error: malformed file list in commit at byte %" PRId64 " of %s\n", start_byte, COMMITS_FILE);
+        exit(EXIT_FAILURE);
+    }
+
+    // append commit with the range of file rows it just added
+    commit_table_append(table, record->id, hash, date, message, record->timestamp, start_byte, end_byte, file_start, table->files.count - file_start);
 }
 
 /**
- * @brief Prints the text between the specified byte start and byte end.
+ * @brief Finds a commit by hash or unique hash prefix and appends it to the commit table.
  *
- * @param byte_start The starting byte position.
- * @param byte_end The ending byte position.
+ * Only the requested commit is read from the commits file.
+ *
+ * @param table The pointer to the commit table.
+ * @param hash The hash of the commit, or at least COMMIT_PREFIX_MIN leading characters of it.
+ * @return 1 if the commit was found, 0 otherwise.
+ *
+ * @note This function terminates the program if the prefix matches more than one commit.
  */
-void print_text_between_bytes(int byte_start, int byte_end) {
-    // Open constants.txt file
-    FILE* file = fopen(CONTENTS_FILE, "r");
-    if (file == NULL) {
-        printf("Error opening file.\n");
-        return;
+int parse_commit_by_hash(CommitTable *table, const char *hash) {
+    if (strlen(hash) < COMMIT_PREFIX_MIN) {
+        printf("vcs: error: hash prefix %s is too short, use at least %d characters\n", hash, COMMIT_PREFIX_MIN);
+        exit(EXIT_FAILURE);
     }
 
-    // Move file pointer to byte_start
-    fseek(file, byte_start, SEEK_SET);
+    // map metadata and commit indexes
+    MetadataIndex* metadata = metadata_open();
+    if (metadata == NULL) {
+        exit(EXIT_FAILURE);
+    }
+    CommitIndex* index = commit_index_open();
+    if (index == NULL) {
+        exit(EXIT_FAILURE);
+    }
+
+    // binary search for the commit slot
+    long slots[2];
+    size_t found = commit_index_resolve(index, metadata, hash, slots);
+    if (found > 1) {
+        printf("vcs: error: hash prefix %s is ambiguous\n", hash);
+        exit(EXIT_FAILURE);
+    }
+    if (found == 1) {
+        parse_commit_record(table, &metadata->records[slots[0]]);
+    }
 
-    // Calculate the size of the text to be read
-    size_t text_size = byte_end - byte_start;
+    commit_index_close(index);
+    metadata_close(metadata);
+    return (found == 1);
+}
 
-    // Allocate memory for the text buffer
-    char* buffer = (char*)malloc(text_size);
-    if (buffer == NULL) {
-        printf("Memory allocation error.\n");
-        fclose(file);
-        return;
+/**
+ * @brief Appends the most recent commit to the commit table.
+ *
+ * @param table The pointer to the commit table.
+ * @return 1 if there is a commit, 0 otherwise.
+ */
+int parse_last_commit(CommitTable *table) {
+    MetadataIndex* metadata = metadata_open();
+    if (metadata == NULL) {
+        exit(EXIT_FAILURE);
     }
 
-    // Read the text from the file
-    size_t bytes_read = fread(buffer, sizeof(char), text_size, file);
-    buffer[bytes_read] = '\0';  // Add null terminator to the end of the buffer
+    int found = (metadata->count > 0);
+    if (found) {
+        parse_commit_record(table, &metadata->records[metadata->count - 1]);
+    }
 
-    // Print the text
-    printf("%s\n",buffer);
+    metadata_close(metadata);
+    return found;
+}
 
-    // Free memory and close the file
-    free(buffer);
-    fclose(file);
+/**
+ * @brief Parses the commits metadata index and populates the commit table with the parsed data.
+ *
+ * @param table The pointer to the commit table.
+ */
+void parse_commits(CommitTable *table) {
+    // map metadata index
+    MetadataIndex* metadata = metadata_open();
+    if (metadata == NULL) {
+        exit(EXIT_FAILURE);
+    }
+
+    // size the columns once, then read records
+    commit_table_reserve(table, metadata->count);
+    for (size_t i = 0; i < metadata->count; i++) {
+        parse_commit_record(table, &metadata->records[i]);
+    }
+    metadata_close(metadata);
 }
 
 /**
- * @brief Writes the text between the specified byte start and byte end to the specified file.
+ * @brief Prints the blob stored between the specified byte start and byte end.
+ *
+ * The blob is written from the mapped contents file straight to standard output.
  *
  * @param byte_start The starting byte position.
  * @param byte_end The ending byte position.
- * @param path The path of the output file.
  */
-void write_text_between_bytes(int byte_start, int byte_end, const char *path) {
-    // Open contents.txt file
-    FILE* input_file = fopen(CONTENTS_FILE, "r");
-    if (input_file == NULL) {
-        printf("Error opening input file.\n");
+void print_text_between_bytes(int64_t byte_start, int64_t byte_end) {
+    // flush buffered output so the blob lands in order
+    fflush(stdout);
+    if (contents_write_blob(byte_start, byte_end, STDOUT_FILENO) == 0) {
+        printf("Error reading contents.\n");
         return;
     }
+    printf("\n");
+}
 
-    // Move file pointer to byte_start
-    fseek(input_file, byte_start, SEEK_SET);
-
-    // Calculate the size of the contents to be read
-    size_t contents_size = byte_end - byte_start;
-
-    // Allocate memory for the contents buffer
-    char* buffer = (char*)malloc(contents_size);
-    if (buffer == NULL) {
-        printf("Memory allocation error.\n");
-        fclose(input_file);
-        return;
+/**
+ * @brief Writes the blob stored between the specified byte start and byte end to the specified file.
+ *
+ * The blob is written from the mapped contents file straight to the output
+ * file. Directories on the way to the file are created if they are missing.
+ *
+ * @param byte_start The starting byte position.
+ * @param byte_end The ending byte position.
+ * @param path The path of the output file.
+ * @return 1 if the file was written successfully, 0 otherwise.
+ */
+int write_text_between_bytes(int64_t byte_start, int64_t byte_end, const char *path) {
+    // Create the parent directories of nested paths
+    if (create_parent_directories(path) == 0) {
+        printf("vcs: error: could not create the directories of %s\n", path);
+        return 0;
     }
 
-    // Read the contents from the input file
-    size_t bytes_read = fread(buffer, sizeof(char), contents_size, input_file);
-    buffer[bytes_read] = '\0';  // Add null terminator to the end of the buffer
-
-    // Close the input file
-    fclose(input_file);
-
     // Open the output file for writing
-    FILE* output_file = fopen(path, "w");
-    if (output_file == NULL) {
+    int output_fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+    if (output_fd < 0) {
         printf("Error opening output file.\n");
-        free(buffer);
-        return;
+        return 0;
     }
 
     // Write the contents to the output file
-    fputs(buffer, output_file);
+    int written = contents_write_blob(byte_start, byte_end, output_fd);
 
     // Close the output file
-    fclose(output_file);
-
-    // Free memory
-    free(buffer);
+    if (close(output_fd) != 0 || written == 0) {
+        printf("Error writing output file.\n");
+        return 0;
+    }
 
-    printf("Contents copied from byte %d to byte %d to file: %s\n", byte_start, byte_end, path);
+    printf("Contents copied from byte %" PRId64 " to byte %" PRId64 " to file: %s\n", byte_start, byte_end, path);
+    return 1;
 }
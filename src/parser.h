@@ -1,12 +1,19 @@
 # ifndef __PARSER_H__
 # define __PARSER_H__
 
+# include <stdint.h>
+
 # include "data_structures.h"
+# include "metadata.h"
+# include "stage.h"
 
 // Function prototypes
-void parse_stage(FileHead *head);
-void parse_commit_file(CommitHead *commit_head, FileHead *file_head, const char *message);
-void parse_commits(CommitHead *commit_head);
-void print_text_between_bytes(int byte_start, int byte_end);
-void write_text_between_bytes(int byte_start, int byte_end, const char *path);
+void parse_stage(const Stage *stage, FileTable *files);
+void parse_commit_file(CommitTable *table, const FileTable *files, const char *message);
+void parse_commit_record(CommitTable *table, const MetadataRecord *record);
+int parse_commit_by_hash(CommitTable *table, const char *hash);
+int parse_last_commit(CommitTable *table);
+void parse_commits(CommitTable *table);
+void print_text_between_bytes(int64_t byte_start, int64_t byte_end);
+int write_text_between_bytes(int64_t byte_start, int64_t byte_end, const char *path);
 # endif
\ No newline at end of file
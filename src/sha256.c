@@ -0,0 +1,257 @@
+/**
+ * @file sha256.c
+ * @brief SHA-256 digest for the VCS (Version Control System).
+ *
+ * This file contains a self-contained SHA-256 implementation (FIPS 180-4)
+ * used to address file contents in the blob store.
+ */
+# include <stdio.h>
+# include <string.h>
+# include <fcntl.h>
+# include <unistd.h>
+
+# include "sha256.h"
+
+static const uint32_t K[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+# define ROTR(x, n) (((x) >> (n)) | ((x) << (32 - (n))))
+
+/**
+ * @brief Processes one 64-byte block of input.
+ *
+ * @param context The digest context.
+ * @param block The block to process.
+ */
+static void sha256_transform(Sha256Context *context, const uint8_t block[64]) {
+    uint32_t w[64];
+    for (int i = 0; i < 16; i++) {
+        w[i] = ((uint32_t)block[i * 4] << 24) | ((uint32_t)block[i * 4 + 1] << 16) |
+               ((uint32_t)block[i * 4 + 2] << 8) | (uint32_t)block[i * 4 + 3];
+    }
+    for (int i = 16; i < 64; i++) {
+        uint32_t s0 = ROTR(w[i - 15], 7) ^ ROTR(w[i - 15], 18) ^ (w[i - 15] >> 3);
+        uint32_t s1 = ROTR(w[i - 2], 17) ^ ROTR(w[i - 2], 19) ^ (w[i - 2] >> 10);
+        w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+    }
+
+    uint32_t a = context->state[0], b = context->state[1], c = context->state[2], d = context->state[3];
+    uint32_t e = context->state[4], f = context->state[5], g = context->state[6], h = context->state[7];
+
+    for (int i = 0; i < 64; i++) {
+        uint32_t s1 = ROTR(e, 6) ^ ROTR(e, 11) ^ ROTR(e, 25);
+        uint32_t ch = (e & f) ^ (~e & g);
+        uint32_t t1 = h + s1 + ch + K[i] + w[i];
+        uint32_t s0 = ROTR(a, 2) ^ ROTR(a, 13) ^ ROTR(a, 22);
+        uint32_t maj = (a & b) ^ (a & c) ^ (b & c);
+        uint32_t t2 = s0 + maj;
+        h = g;
+        g = f;
+        f = e;
+        e = d + t1;
+        d = c;
+        c = b;
+        b = a;
+        a = t1 + t2;
+    }
+
+    context->state[0] += a;
+    context->state[1] += b;
+    context->state[2] += c;
+    context->state[3] += d;
+    context->state[4] += e;
+    context->state[5] += f;
+    context->state[6] += g;
+    context->state[7] += h;
+}
+
+/**
+ * @brief Initializes a digest context.
+ *
+ * @param context The digest context to initialize.
+ */
+void sha256_init(Sha256Context *context) {
+    context->state[0] = 0x6a09e667;
+    context->state[1] = 0xbb67ae85;
+    context->state[2] = 0x3c6ef372;
+    context->state[3] = 0xa54ff53a;
+    context->state[4] = 0x510e527f;
+    context->state[5] = 0x9b05688c;
+    context->state[6] = 0x1f83d9ab;
+    context->state[7] = 0x5be0cd19;
+    context->length = 0;
+    context->buffer_size = 0;
+}
+
+/**
+ * @brief Feeds data into a digest context.
+ *
+ * @param context The digest context.
+ * @param data The data to hash.
+ * @param size The number of bytes in data.
+ */
+void sha256_update(Sha256Context *context, const void *data, size_t size) {
+    const uint8_t *bytes = (const uint8_t *)data;
+    context->length += size;
+
+    // fill a partially filled block first
+    if (context->buffer_size > 0) {
+        size_t take = 64 - context->buffer_size;
+        if (take > size) {
+            take = size;
+        }
+        memcpy(context->buffer + context->buffer_size, bytes, take);
+        context->buffer_size += take;
+        bytes += take;
+        size -= take;
+        if (context->buffer_size < 64) {
+            return;
+        }
+        sha256_transform(context, context->buffer);
+        context->buffer_size = 0;
+    }
+
+    // process whole blocks straight from the input
+    while (size >= 64) {
+        sha256_transform(context, bytes);
+        bytes += 64;
+        size -= 64;
+    }
+
+    // keep the tail for the next call
+    memcpy(context->buffer, bytes, size);
+    context->buffer_size = size;
+}
+
+/**
+ * @brief Finishes a digest and writes the 32-byte result.
+ *
+ * @param context The digest context.
+ * @param digest The output digest.
+ */
+void sha256_final(Sha256Context *context, uint8_t digest[DIGEST_SIZE]) {
+    uint64_t bit_length = context->length * 8;
+
+    // append the padding bit and zeros up to the length field
+    uint8_t pad = 0x80;
+    sha256_update(context, &pad, 1);
+    uint8_t zero = 0;
+    while (context->buffer_size != 56) {
+        sha256_update(context, &zero, 1);
+    }
+
+    // append the message length in bits, big endian
+    uint8_t length[8];
+    for (int i = 0; i < 8; i++) {
+        length[i] = (uint8_t)(bit_length >> (56 - i * 8));
+    }
+    sha256_update(context, length, 8);
+
+    for (int i = 0; i < 8; i++) {
+        digest[i * 4] = (uint8_t)(context->state[i] >> 24);
+        digest[i * 4 + 1] = (uint8_t)(context->state[i] >> 16);
+        digest[i * 4 + 2] = (uint8_t)(context->state[i] >> 8);
+        digest[i * 4 + 3] = (uint8_t)context->state[i];
+    }
+}
+
+/**
+ * @brief Converts a binary digest to a lowercase hexadecimal string.
+ *
+ * @param digest The binary digest.
+ * @param hex The output string, DIGEST_HEX_SIZE bytes including the terminator.
+ */
+void digest_to_hex(const uint8_t digest[DIGEST_SIZE], char hex[DIGEST_HEX_SIZE]) {
+    const char *hex_chars = "0123456789abcdef";
+    for (int i = 0; i < DIGEST_SIZE; i++) {
+        hex[i * 2] = hex_chars[digest[i] >> 4];
+        hex[i * 2 + 1] = hex_chars[digest[i] & 0x0f];
+    }
+    hex[DIGEST_HEX_SIZE - 1] = '\0';
+}
+
+/**
+ * @brief Converts a hexadecimal string to a binary digest.
+ *
+ * Strings shorter than a full digest (such as the 40-character identifiers of
+ * older repositories) are zero-padded on the right.
+ *
+ * @param hex The hexadecimal string, upper or lower case.
+ * @param digest The output digest.
+ * @return 1 if the string is valid hexadecimal of at most 64 characters, 0 otherwise.
+ */
+int hex_to_digest(const char *hex, uint8_t digest[DIGEST_SIZE]) {
+    size_t length = strlen(hex);
+    if (length > DIGEST_SIZE * 2) {
+        return 0;
+    }
+
+    memset(digest, 0, DIGEST_SIZE);
+    for (size_t i = 0; i < length; i++) {
+        int value;
+        char c = hex[i];
+        if (c >= '0' && c <= '9') {
+            value = c - '0';
+        } else if (c >= 'a' && c <= 'f') {
+            value = c - 'a' + 10;
+        } else if (c >= 'A' && c <= 'F') {
+            value = c - 'A' + 10;
+        } else {
+            return 0;
+        }
+        digest[i / 2] |= (uint8_t)((i % 2 == 0) ? value << 4 : value);
+    }
+    return 1;
+}
+
+/**
+ * @brief Hashes a buffer and writes the hexadecimal digest.
+ *
+ * @param data The data to hash.
+ * @param size The number of bytes in data.
+ * @param hex The output string, DIGEST_HEX_SIZE bytes including the terminator.
+ */
+void sha256_hex(const void *data, size_t size, char hex[DIGEST_HEX_SIZE]) {
+    Sha256Context context;
+    uint8_t digest[DIGEST_SIZE];
+    sha256_init(&context);
+    sha256_update(&context, data, size);
+    sha256_final(&context, digest);
+    digest_to_hex(digest, hex);
+}
+
+/**
+ * @brief Hashes the content of a file, reading it in blocks.
+ *
+ * @param path The path of the file.
+ * @param digest The output digest.
+ * @return 1 if the file was read and hashed, 0 otherwise.
+ */
+int sha256_file(const char *path, uint8_t digest[DIGEST_SIZE]) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return 0;
+    }
+
+    Sha256Context context;
+    sha256_init(&context);
+    uint8_t buffer[65536];
+    ssize_t length;
+    while ((length = read(fd, buffer, sizeof(buffer))) > 0) {
+        sha256_update(&context, buffer, (size_t)length);
+    }
+    close(fd);
+    if (length < 0) {
+        return 0;
+    }
+    sha256_final(&context, digest);
+    return 1;
+}
@@ -0,0 +1,29 @@
+# ifndef __SHA256_H__
+# define __SHA256_H__
+
+# include <stddef.h>
+# include <stdint.h>
+
+/// Sizes
+# define DIGEST_SIZE 32
+# define DIGEST_HEX_SIZE 65
+
+typedef struct sha256_context Sha256Context;
+
+struct sha256_context {
+    uint32_t state[8];
+    uint64_t length;
+    uint8_t buffer[64];
+    size_t buffer_size;
+};
+
+// function prototypes
+void sha256_init(Sha256Context *context);
+void sha256_update(Sha256Context *context, const void *data, size_t size);
+void sha256_final(Sha256Context *context, uint8_t digest[DIGEST_SIZE]);
+void sha256_hex(const void *data, size_t size, char hex[DIGEST_HEX_SIZE]);
+int sha256_file(const char *path, uint8_t digest[DIGEST_SIZE]);
+void digest_to_hex(const uint8_t digest[DIGEST_SIZE], char hex[DIGEST_HEX_SIZE]);
+int hex_to_digest(const char *hex, uint8_t digest[DIGEST_SIZE]);
+
+# endif
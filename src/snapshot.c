@@ -0,0 +1,481 @@
+/**
+ * @file snapshot.c
+ * @brief File snapshots for the VCS (Version Control System).
+ *
+ * A snapshot stores the current content of a file in the blob store and
+ * returns the blob. Files whose stat data matches the stat cache reuse their
+ * stored blob without being read; other files are streamed into the store,
+ * as a delta against their version in the last commit when that is smaller.
+ *
+ * Many files are stored through a pipeline. A pool of threads takes files in
+ * order, reads them, hashes them and encodes their records, while the calling
+ * thread writes the encoded records in order, so the contents file comes out
+ * the same as if the files were stored one by one. The blob index is shared
+ * under a lock. Files large enough to be chunked are streamed by the writer
+ * itself, and reading stops once too many bytes wait to be written.
+ */
+# include <stdio.h>
+# include <stdlib.h>
+# include <string.h>
+# include <fcntl.h>
+# include <unistd.h>
+# include <pthread.h>
+# include <sys/stat.h>
+
+# include "validations.h"
+# include "files.h"
+# include "chunk.h"
+# include "parser.h"
+# include "snapshot.h"
+
+/// States
+# define ITEM_PENDING 0
+# define ITEM_FOUND 1
+# define ITEM_ENCODED 2
+# define ITEM_LARGE 3
+# define ITEM_FAILED 4
+
+typedef struct snapshot_item SnapshotItem;
+typedef struct snapshot_pipeline SnapshotPipeline;
+
+/**
+ * One file on its way through the pipeline. A found file already has its
+ * blob, an encoded one has a payload to write, and a large one is left for
+ * the writer to stream. Cached is set when the blob came from the stat
+ * cache, whose entry then needs no update. Bytes counts the content held
+ * until the item is written.
+ */
+struct snapshot_item {
+    int state;
+    int has_stat;
+    int cached;
+    int has_base;
+    size_t bytes;
+    struct stat st;
+    Blob base;
+    char* content;
+    BlobPayload payload;
+    Blob blob;
+};
+
+/**
+ * Files shared by the encoding threads and the writer. Next is the first
+ * file no thread took yet, written the number of files written so far, and
+ * pending the bytes read but not written yet.
+ */
+struct snapshot_pipeline {
+    pthread_mutex_t lock;
+    pthread_cond_t ready;
+    pthread_cond_t room;
+    pthread_mutex_t index_lock;
+    Snapshot* snapshot;
+    char* const* paths;
+    SnapshotItem* items;
+    size_t count;
+    size_t next;
+    size_t written;
+    size_t pending;
+};
+
+/**
+ * @brief Hashes a path with 64-bit FNV-1a.
+ *
+ * @param path The path.
+ * @return The hash.
+ */
+static uint64_t snapshot_hash(const char* path) {
+    uint64_t hash = 14695981039346656037ULL;
+    for (const unsigned char* c = (const unsigned char*)path; *c != '\0'; c++) {
+        hash ^= *c;
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+/**
+ * @brief Finds the slot of a path among the files of the last commit, or the empty slot where it would go.
+ *
+ * @param snapshot The snapshot.
+ * @param path The path.
+ * @return The slot position.
+ */
+static size_t snapshot_slot(const Snapshot* snapshot, const char* path) {
+    const FileTable* files = &snapshot->previous->files;
+    size_t mask = snapshot->previous_slot_count - 1;
+    for (size_t i = (size_t)snapshot_hash(path) & mask;; i = (i + 1) & mask) {
+        uint32_t slot = snapshot->previous_slots[i];
+        if (slot == 0 || strcmp(files->paths[slot - 1], path) == 0) {
+            return i;
+        }
+    }
+}
+
+/**
+ * @brief Hashes the files of the last commit by path.
+ *
+ * @param snapshot The snapshot, whose last commit is parsed.
+ * @param arena The arena of the command.
+ */
+static void snapshot_index_previous(Snapshot* snapshot, Arena* arena) {
+    const CommitTable* table = snapshot->previous;
+    size_t start = (table->count > 0) ? table->file_starts[table->count - 1] : 0;
+    size_t count = (table->count > 0) ? table->file_counts[table->count - 1] : 0;
+
+    size_t slot_count = 16;
+    while (slot_count < count * 2) {
+        slot_count *= 2;
+    }
+    snapshot->previous_slots = (uint32_t*)arena_alloc(arena, slot_count * sizeof(uint32_t));
+    if (snapshot->previous_slots == NULL) {
+        printf("vcs: error: could not allocate memory for snapshot\n");
+        exit(EXIT_FAILURE);
+    }
+    memset(snapshot->previous_slots, 0, slot_count * sizeof(uint32_t));
+    snapshot->previous_slot_count = slot_count;
+    for (size_t row = start; row < start + count; row++) {
+        snapshot->previous_slots[snapshot_slot(snapshot, table->files.paths[row])] = (uint32_t)(row + 1);
+    }
+}
+
+/**
+ * @brief Finds the stored version of a path in the last commit.
+ *
+ * @param snapshot The snapshot.
+ * @param path The file path.
+ * @param base Receives the byte range of the stored version.
+ * @return 1 if the last commit contains the path, 0 otherwise.
+ */
+static int previous_version(const Snapshot* snapshot, const char* path, Blob* base) {
+    uint32_t slot = snapshot->previous_slots[snapshot_slot(snapshot, path)];
+    if (slot == 0) {
+        return 0;
+    }
+    size_t row = slot - 1;
+    const FileTable* files = &snapshot->previous->files;
+    strcpy(base->digest, (files->digests[row] != NULL) ? files->digests[row] : "");
+    base->start_byte = files->start_bytes[row];
+    base->end_byte = files->end_bytes[row];
+    return 1;
+}
+
+/**
+ * @brief Loads what storing file contents needs.
+ *
+ * @param arena The arena of the command.
+ * @return A pointer to the opened Snapshot.
+ *
+ * @note This function terminates the program if the blob index cannot be loaded.
+ */
+Snapshot* snapshot_open(Arena* arena) {
+    Snapshot* snapshot = (Snapshot*)arena_alloc(arena, sizeof(Snapshot));
+    if (snapshot == NULL) {
+        printf("vcs: error: could not allocate memory for snapshot\n");
+        exit(EXIT_FAILURE);
+    }
+
+    // load blob index
+    snapshot->blobs = blob_index_load();
+    if (snapshot->blobs == NULL) {
+        printf("vcs: error: could not load %s\n", BLOBS_FILE);
+        exit(EXIT_FAILURE);
+    }
+
+    // stat data of files when they were last stored
+    snapshot->cache = stat_cache_load(arena);
+    if (snapshot->cache == NULL) {
+        exit(EXIT_FAILURE);
+    }
+
+    // previous versions of files come from the last commit
+    snapshot->previous = commit_table_create(arena);
+    parse_last_commit(snapshot->previous);
+    snapshot_index_previous(snapshot, arena);
+    return snapshot;
+}
+
+/**
+ * @brief Stores the current content of a file unless an identical blob exists.
+ *
+ * @param snapshot The snapshot.
+ * @param path The path of the file.
+ * @return The blob the content is stored as, or NULL if it could not be stored.
+ */
+Blob* snapshot_file(Snapshot* snapshot, const char* path) {
+    // unchanged files keep the blob they were stored as
+    struct stat st;
+    int has_stat = (stat(path, &st) == 0);
+    const uint8_t* cached = has_stat ? stat_cache_lookup(snapshot->cache, path, &st) : NULL;
+    if (cached != NULL) {
+        char digest[DIGEST_HEX_SIZE];
+        digest_to_hex(cached, digest);
+        Blob* blob = blob_index_find(snapshot->blobs, digest);
+        if (blob != NULL) {
+            return blob;
+        }
+    }
+
+    // otherwise stream file contents into the store
+    Blob base;
+    int has_base = previous_version(snapshot, path, &base);
+    Blob* blob = blob_store_file(snapshot->blobs, path, has_base ? &base : NULL);
+    if (blob != NULL && has_stat) {
+        uint8_t digest[DIGEST_SIZE];
+        hex_to_digest(blob->digest, digest);
+        stat_cache_update(snapshot->cache, path, &st, digest);
+    }
+    return blob;
+}
+
+/**
+ * @brief Reads a file of the pipeline, hashes it and encodes its record.
+ *
+ * @param pipeline The pipeline.
+ * @param i The position of the file.
+ */
+static void snapshot_prepare(SnapshotPipeline* pipeline, size_t i) {
+    SnapshotItem* item = &pipeline->items[i];
+    const char* path = pipeline->paths[i];
+    Snapshot* snapshot = pipeline->snapshot;
+    int state = ITEM_FAILED;
+
+    // unchanged files keep the blob they were stored as
+    item->has_stat = (stat(path, &item->st) == 0);
+    const uint8_t* cached = item->has_stat ? stat_cache_lookup(snapshot->cache, path, &item->st) : NULL;
+    if (cached != NULL) {
+        char digest[DIGEST_HEX_SIZE];
+        digest_to_hex(cached, digest);
+        pthread_mutex_lock(&pipeline->index_lock);
+        Blob* blob = blob_index_find(snapshot->blobs, digest);
+        if (blob != NULL) {
+            item->blob = *blob;
+            item->cached = 1;
+            state = ITEM_FOUND;
+        }
+        pthread_mutex_unlock(&pipeline->index_lock);
+    }
+
+    int fd = -1;
+    if (state == ITEM_FOUND || !item->has_stat) {
+        // nothing to read
+    } else if (item->st.st_size >= CHUNK_THRESHOLD) {
+        state = ITEM_LARGE;
+    } else if ((fd = open(path, O_RDONLY)) >= 0 && (item->content = malloc((size_t)item->st.st_size + 1)) != NULL) {
+        // read no more than the size the file had when it was stat'ed
+        size_t size = 0;
+        ssize_t bytes_read = 1;
+        while (size < (size_t)item->st.st_size && (bytes_read = read(fd, item->content + size, (size_t)item->st.st_size - size)) > 0) {
+            size += (size_t)bytes_read;
+        }
+        if (bytes_read >= 0) {
+            item->bytes = size;
+            sha256_hex(item->content, size, item->payload.digest);
+
+            pthread_mutex_lock(&pipeline->index_lock);
+            Blob* blob = blob_index_find(snapshot->blobs, item->payload.digest);
+            if (blob != NULL) {
+                item->blob = *blob;
+            }
+            pthread_mutex_unlock(&pipeline->index_lock);
+
+            // identical content needs no record
+            if (blob != NULL) {
+                state = ITEM_FOUND;
+            } else {
+                blob_encode(&item->payload, item->content, size, item->has_base ? &item->base : NULL);
+                state = ITEM_ENCODED;
+            }
+        }
+        if (state != ITEM_ENCODED || item->payload.owned != NULL) {
+            free(item->content);
+            item->content = NULL;
+        }
+    }
+    if (fd >= 0) {
+        close(fd);
+    }
+
+    pthread_mutex_lock(&pipeline->lock);
+    item->state = state;
+    pipeline->pending += item->bytes;
+    pthread_cond_broadcast(&pipeline->ready);
+    pthread_mutex_unlock(&pipeline->lock);
+}
+
+/**
+ * @brief Prepares files of the pipeline in order until none are left.
+ *
+ * A thread waits while too many bytes wait to be written, unless the writer
+ * waits for the very file it would take next.
+ *
+ * @param argument The pipeline.
+ * @return NULL.
+ */
+static void* snapshot_worker(void* argument) {
+    SnapshotPipeline* pipeline = (SnapshotPipeline*)argument;
+    for (;;) {
+        pthread_mutex_lock(&pipeline->lock);
+        while (pipeline->next < pipeline->count && pipeline->next > pipeline->written && pipeline->pending >= SNAPSHOT_MAX_PENDING) {
+            pthread_cond_wait(&pipeline->room, &pipeline->lock);
+        }
+        if (pipeline->next >= pipeline->count) {
+            pthread_mutex_unlock(&pipeline->lock);
+            return NULL;
+        }
+        size_t i = pipeline->next++;
+        pthread_mutex_unlock(&pipeline->lock);
+
+        snapshot_prepare(pipeline, i);
+    }
+}
+
+/**
+ * @brief Writes one prepared file to the blob store.
+ *
+ * @param pipeline The pipeline.
+ * @param i The position of the file.
+ * @param blobs_file The blobs file, opened on the first write.
+ */
+static void snapshot_write(SnapshotPipeline* pipeline, size_t i, FILE** blobs_file) {
+    SnapshotItem* item = &pipeline->items[i];
+    BlobIndex* index = pipeline->snapshot->blobs;
+    Blob* blob = NULL;
+
+    pthread_mutex_lock(&pipeline->index_lock);
+    if (item->state == ITEM_ENCODED) {
+        if (*blobs_file == NULL) {
+            *blobs_file = open_file(BLOBS_FILE, "a");
+        }
+        blob = (*blobs_file != NULL) ? blob_write(index, *blobs_file, &item->payload) : NULL;
+    } else if (item->state == ITEM_LARGE) {
+        // chunks append their own lines to the blobs file
+        if (*blobs_file != NULL) {
+            fflush(*blobs_file);
+        }
+        blob = blob_store_file(index, pipeline->paths[i], item->has_base ? &item->base : NULL);
+    }
+    if (blob != NULL) {
+        item->blob = *blob;
+    } else if (item->state == ITEM_ENCODED || item->state == ITEM_LARGE) {
+        item->state = ITEM_FAILED;
+    }
+    pthread_mutex_unlock(&pipeline->index_lock);
+
+    blob_payload_free(&item->payload);
+    free(item->content);
+    item->content = NULL;
+
+    pthread_mutex_lock(&pipeline->lock);
+    pipeline->pending -= item->bytes;
+    pipeline->written = i + 1;
+    pthread_cond_broadcast(&pipeline->room);
+    pthread_mutex_unlock(&pipeline->lock);
+}
+
+/**
+ * @brief Stores the current content of many files unless identical blobs exist.
+ *
+ * @param snapshot The snapshot.
+ * @param paths The paths of the files.
+ * @param count The number of files.
+ * @param blobs Receives the blob of each file, with an empty digest for files that could not be stored.
+ * @return The number of files stored.
+ */
+size_t snapshot_files(Snapshot* snapshot, char* const* paths, size_t count, Blob* blobs) {
+    SnapshotPipeline pipeline;
+    memset(&pipeline, 0, sizeof(pipeline));
+    pipeline.snapshot = snapshot;
+    pipeline.paths = paths;
+    pipeline.count = count;
+    pipeline.items = calloc(count + 1, sizeof(SnapshotItem));
+    if (pipeline.items == NULL || blob_store_prepare() == 0) {
+        printf("vcs: error: could not prepare the blob store\n");
+        free(pipeline.items);
+        memset(blobs, 0, count * sizeof(Blob));
+        return 0;
+    }
+
+    // bases come from the last commit, looked up before any thread starts
+    for (size_t i = 0; i < count; i++) {
+        pipeline.items[i].has_base = previous_version(snapshot, paths[i], &pipeline.items[i].base);
+    }
+
+    pthread_mutex_init(&pipeline.lock, NULL);
+    pthread_cond_init(&pipeline.ready, NULL);
+    pthread_cond_init(&pipeline.room, NULL);
+    pthread_mutex_init(&pipeline.index_lock, NULL);
+
+    long processors = sysconf(_SC_NPROCESSORS_ONLN);
+    size_t thread_count = (processors < 1) ? 1 : (size_t)processors;
+    if (thread_count > SNAPSHOT_MAX_THREADS) {
+        thread_count = SNAPSHOT_MAX_THREADS;
+    }
+    if (thread_count > count / SNAPSHOT_FILES_PER_THREAD) {
+        thread_count = count / SNAPSHOT_FILES_PER_THREAD;
+    }
+    pthread_t threads[SNAPSHOT_MAX_THREADS];
+    size_t started = 0;
+    while (started < thread_count && pthread_create(&threads[started], NULL, snapshot_worker, &pipeline) == 0) {
+        started++;
+    }
+
+    // write in order, preparing the next file here whenever no thread took it yet
+    FILE* blobs_file = NULL;
+    for (size_t i = 0; i < count; i++) {
+        pthread_mutex_lock(&pipeline.lock);
+        while (pipeline.items[i].state == ITEM_PENDING) {
+            if (pipeline.next == i) {
+                pipeline.next++;
+                pthread_mutex_unlock(&pipeline.lock);
+                snapshot_prepare(&pipeline, i);
+                pthread_mutex_lock(&pipeline.lock);
+            } else {
+                pthread_cond_wait(&pipeline.ready, &pipeline.lock);
+            }
+        }
+        pthread_mutex_unlock(&pipeline.lock);
+        snapshot_write(&pipeline, i, &blobs_file);
+    }
+    for (size_t i = 0; i < started; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    if (blobs_file != NULL && fclose(blobs_file) != 0) {
+        printf("vcs: error: could not write %s\n", BLOBS_FILE);
+    }
+
+    pthread_mutex_destroy(&pipeline.index_lock);
+    pthread_cond_destroy(&pipeline.room);
+    pthread_cond_destroy(&pipeline.ready);
+    pthread_mutex_destroy(&pipeline.lock);
+
+    // the cache learns the stat data of every file that was read
+    size_t stored = 0;
+    for (size_t i = 0; i < count; i++) {
+        SnapshotItem* item = &pipeline.items[i];
+        if (item->state == ITEM_FAILED) {
+            memset(&blobs[i], 0, sizeof(Blob));
+            continue;
+        }
+        blobs[i] = item->blob;
+        stored++;
+        if (item->has_stat && !item->cached) {
+            uint8_t digest[DIGEST_SIZE];
+            hex_to_digest(item->blob.digest, digest);
+            stat_cache_update(snapshot->cache, paths[i], &item->st, digest);
+        }
+    }
+    free(pipeline.items);
+    return stored;
+}
+
+/**
+ * @brief Writes the stat cache back and releases the snapshot.
+ *
+ * @param snapshot The snapshot.
+ */
+void snapshot_close(Snapshot* snapshot) {
+    // a stale cache only costs reads on the next snapshot
+    stat_cache_save(snapshot->cache);
+
+    commit_table_destroy(snapshot->previous);
+    blob_index_destroy(snapshot->blobs);
+}
@@ -0,0 +1,39 @@
+# ifndef __SNAPSHOT_H__
+# define __SNAPSHOT_H__
+
+# include <stddef.h>
+# include <stdint.h>
+
+# include "arena.h"
+# include "blobs.h"
+# include "cache.h"
+# include "data_structures.h"
+
+/// Settings
+# define SNAPSHOT_MAX_THREADS 32
+# define SNAPSHOT_FILES_PER_THREAD 16
+# define SNAPSHOT_MAX_PENDING (64 * 1024 * 1024)
+
+typedef struct snapshot Snapshot;
+
+/**
+ * What storing file contents needs: the blob index for deduplication, the
+ * stat cache to skip unchanged files, and the last commit, whose versions
+ * of the files are the delta bases. The slots hash the file rows of the
+ * last commit by path, like the stage, holding the row plus one.
+ */
+struct snapshot {
+    BlobIndex* blobs;
+    StatCache* cache;
+    CommitTable* previous;
+    uint32_t* previous_slots;
+    size_t previous_slot_count;
+};
+
+// function prototypes
+Snapshot* snapshot_open(Arena* arena);
+Blob* snapshot_file(Snapshot* snapshot, const char* path);
+size_t snapshot_files(Snapshot* snapshot, char* const* paths, size_t count, Blob* blobs);
+void snapshot_close(Snapshot* snapshot);
+
+# endif
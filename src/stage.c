@@ -0,0 +1,388 @@
+/**
+ * @file stage.c
+ * @brief Staging index for the VCS (Version Control System).
+ *
+ * The stage is kept in a binary index: a 16-byte header holding the magic,
+ * the format version and the number of entries, followed by the entries in
+ * the order they were added. Each entry is the digest and byte range of the
+ * blob the file was stored as, followed by its NUL-terminated path; version 1
+ * entries are the path alone. A command reads the index once into its
+ * arena, looks paths up through a hash set and writes the index back once,
+ * so adding n paths takes linear time.
+ * Repositories that still have the older stage.txt are converted the first
+ * time the stage is loaded.
+ */
+# include <stdio.h>
+# include <stdlib.h>
+# include <string.h>
+
+# include "validations.h"
+# include "files.h"
+# include "stage.h"
+# include "tokenizer.h"
+# include "journal.h"
+
+/// Settings
+# define STAGE_MIN_CAPACITY 16
+
+/**
+ * @brief Hashes a path with 64-bit FNV-1a.
+ *
+ * @param path The path.
+ * @return The hash.
+ */
+static uint64_t stage_hash(const char* path) {
+    uint64_t hash = 14695981039346656037ULL;
+    for (const unsigned char* c = (const unsigned char*)path; *c != '\0'; c++) {
+        hash ^= *c;
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+/**
+ * @brief Finds the slot of a path, or the empty slot where it would go.
+ *
+ * @param stage The stage.
+ * @param path The path.
+ * @return The slot position.
+ */
+static size_t stage_slot(const Stage* stage, const char* path) {
+    size_t mask = stage->slot_count - 1;
+    for (size_t i = (size_t)stage_hash(path) & mask;; i = (i + 1) & mask) {
+        uint32_t slot = stage->slots[i];
+        if (slot == 0 || strcmp(stage->paths[slot - 1], path) == 0) {
+            return i;
+        }
+    }
+}
+
+/**
+ * @brief Allocates from the arena of the stage, terminating the program on failure.
+ *
+ * @param stage The stage.
+ * @param size The number of bytes to allocate.
+ * @return The allocation.
+ */
+static void* stage_alloc(Stage* stage, size_t size) {
+    void* pointer = arena_alloc(stage->arena, size);
+    if (pointer == NULL) {
+        printf("vcs: error: could not allocate memory for stage\n");
+        exit(EXIT_FAILURE);
+    }
+    return pointer;
+}
+
+/**
+ * @brief Makes room for at least the given number of paths.
+ *
+ * The hash set is kept at most half full, and is rebuilt when it grows.
+ *
+ * @param stage The stage.
+ * @param capacity The number of paths to make room for.
+ */
+void stage_reserve(Stage* stage, size_t capacity) {
+    if (capacity <= stage->capacity) {
+        return;
+    }
+
+    char** paths = (char**)stage_alloc(stage, capacity * sizeof(char*));
+    uint8_t (*digests)[DIGEST_SIZE] = stage_alloc(stage, capacity * DIGEST_SIZE);
+    int64_t* start_bytes = (int64_t*)stage_alloc(stage, capacity * sizeof(int64_t));
+    int64_t* end_bytes = (int64_t*)stage_alloc(stage, capacity * sizeof(int64_t));
+    if (stage->count > 0) {
+        memcpy(paths, stage->paths, stage->count * sizeof(char*));
+        memcpy(digests, stage->digests, stage->count * DIGEST_SIZE);
+        memcpy(start_bytes, stage->start_bytes, stage->count * sizeof(int64_t));
+        memcpy(end_bytes, stage->end_bytes, stage->count * sizeof(int64_t));
+    }
+    stage->paths = paths;
+    stage->digests = digests;
+    stage->start_bytes = start_bytes;
+    stage->end_bytes = end_bytes;
+    stage->capacity = capacity;
+
+    size_t slot_count = STAGE_MIN_CAPACITY;
+    while (slot_count < capacity * 2) {
+        slot_count *= 2;
+    }
+    if (slot_count > stage->slot_count) {
+        stage->slots = (uint32_t*)stage_alloc(stage, slot_count * sizeof(uint32_t));
+        memset(stage->slots, 0, slot_count * sizeof(uint32_t));
+        stage->slot_count = slot_count;
+        for (size_t i = 0; i < stage->count; i++) {
+            stage->slots[stage_slot(stage, stage->paths[i])] = (uint32_t)(i + 1);
+        }
+    }
+}
+
+/**
+ * @brief Stages a path with the blob it was stored as.
+ *
+ * @param stage The stage.
+ * @param path The path.
+ * @param copy 1 to copy the path into the arena, 0 if it already lives there.
+ * @param digest The digest of the blob, or NULL if the content is stored at commit time.
+ * @param start_byte The start byte of the blob.
+ * @param end_byte The end byte of the blob.
+ * @return STAGE_ADDED for a new path, STAGE_UPDATED if the staged blob changed, STAGE_UNCHANGED otherwise.
+ */
+static int stage_add(Stage* stage, char* path, int copy, const uint8_t* digest, int64_t start_byte, int64_t end_byte) {
+    if (stage->count == stage->capacity) {
+        stage_reserve(stage, stage->capacity * 2);
+    }
+    if (digest == NULL) {
+        start_byte = -1;
+        end_byte = -1;
+    }
+
+    size_t i = stage_slot(stage, path);
+    size_t row = stage->slots[i];
+    int result = STAGE_UPDATED;
+    if (row == 0) {
+        if (copy) {
+            path = arena_strdup(stage->arena, path);
+            if (path == NULL) {
+                printf("vcs: error: could not allocate memory for stage\n");
+                exit(EXIT_FAILURE);
+            }
+        }
+        row = stage->count;
+        stage->paths[row] = path;
+        stage->slots[i] = (uint32_t)(++stage->count);
+        result = STAGE_ADDED;
+    } else {
+        row--;
+        if (stage->start_bytes[row] == start_byte && stage->end_bytes[row] == end_byte && (digest == NULL || memcmp(stage->digests[row], digest, DIGEST_SIZE) == 0)) {
+            return STAGE_UNCHANGED;
+        }
+    }
+
+    if (digest != NULL) {
+        memcpy(stage->digests[row], digest, DIGEST_SIZE);
+    } else {
+        memset(stage->digests[row], 0, DIGEST_SIZE);
+    }
+    stage->start_bytes[row] = start_byte;
+    stage->end_bytes[row] = end_byte;
+    return result;
+}
+
+/**
+ * @brief Writes a stage index to a file.
+ *
+ * The index is written to a temporary file and renamed into place, so an
+ * interrupted write leaves the previous index untouched.
+ *
+ * @param path The path of the index.
+ * @param stage The stage to write, or NULL for an empty index.
+ * @return 1 if the index was written successfully, 0 otherwise.
+ */
+static int stage_write(const char* path, const Stage* stage) {
+    char temporary[256];
+    snprintf(temporary, sizeof(temporary), "%s.tmp", path);
+
+    FILE* file = fopen(temporary, "wb");
+    if (file == NULL) {
+        printf("vcs: error: could not create %s file\n", temporary);
+        return 0;
+    }
+
+    uint32_t version = STAGE_VERSION;
+    uint64_t count = (stage != NULL) ? (uint64_t)stage->count : 0;
+    int ok = (fwrite(STAGE_MAGIC, 1, 4, file) == 4);
+    ok = ok && (fwrite(&version, sizeof(version), 1, file) == 1);
+    ok = ok && (fwrite(&count, sizeof(count), 1, file) == 1);
+    for (size_t i = 0; ok && i < count; i++) {
+        size_t length = strlen(stage->paths[i]) + 1;
+        ok = (fwrite(stage->digests[i], 1, DIGEST_SIZE, file) == DIGEST_SIZE);
+        ok = ok && (fwrite(&stage->start_bytes[i], sizeof(int64_t), 1, file) == 1);
+        ok = ok && (fwrite(&stage->end_bytes[i], sizeof(int64_t), 1, file) == 1);
+        ok = ok && (fwrite(stage->paths[i], 1, length, file) == length);
+    }
+
+    // the new index must be on disk before it replaces the old one
+    ok = ok && journal_sync_file(file);
+    if (fclose(file) != 0) {
+        ok = 0;
+    }
+    if (ok && rename(temporary, path) == 0) {
+        return 1;
+    }
+    remove(temporary);
+    printf("vcs: error: could not write %s file\n", path);
+    return 0;
+}
+
+/**
+ * @brief Creates an empty stage index.
+ *
+ * @param path The path of the index to create.
+ * @return 1 if the index was created successfully, 0 otherwise.
+ */
+int stage_create(const char* path) {
+    return stage_write(path, NULL);
+}
+
+/**
+ * @brief Reads the legacy text stage, one path per line, and replaces it with the index.
+ *
+ * @param stage The empty stage to fill.
+ * @return 1 if the conversion succeeded, 0 otherwise.
+ */
+static int stage_convert_legacy(Stage* stage) {
+    LineReader reader;
+    if (line_reader_open(&reader, LEGACY_STAGE_FILE) == 0) {
+        return 0;
+    }
+    char* line;
+    while ((line = line_reader_next(&reader, NULL)) != NULL) {
+        if (*line != '\0') {
+            stage_add(stage, line, 1, NULL, -1, -1);
+        }
+    }
+    line_reader_close(&reader);
+
+    if (stage_save(stage) == 0) {
+        return 0;
+    }
+    remove(LEGACY_STAGE_FILE);
+    return 1;
+}
+
+/**
+ * @brief Reads the paths of the stage index into the stage.
+ *
+ * The paths are used in place in the buffer the index is read into. Entries
+ * of a version 1 index have no blob and are stored at commit time.
+ *
+ * @param stage The empty stage to fill.
+ * @return 1 if the index was read successfully, 0 otherwise.
+ */
+static int stage_read(Stage* stage) {
+    FILE* file = open_file(STAGE_FILE, "rb");
+    if (file == NULL) {
+        return 0;
+    }
+    fseeko(file, 0, SEEK_END);
+    size_t size = (size_t)ftello(file);
+    rewind(file);
+
+    // terminate the buffer, so a truncated index cannot run past it
+    char* data = (char*)stage_alloc(stage, size + 1);
+    size_t bytes_read = fread(data, 1, size, file);
+    fclose(file);
+    data[bytes_read] = '\0';
+
+    uint32_t version = 0;
+    uint64_t count = 0;
+    if (bytes_read >= STAGE_HEADER_SIZE) {
+        memcpy(&version, data + 4, sizeof(version));
+        memcpy(&count, data + 8, sizeof(count));
+    }
+    if (bytes_read < STAGE_HEADER_SIZE || memcmp(data, STAGE_MAGIC, 4) != 0 || (version != STAGE_VERSION && version != STAGE_VERSION_PATHS)) {
+        printf("vcs: error: %s is not a stage index\n", STAGE_FILE);
+        return 0;
+    }
+
+    stage_reserve(stage, (size_t)count);
+    char* cursor = data + STAGE_HEADER_SIZE;
+    char* end = data + bytes_read;
+    size_t blob_size = (version == STAGE_VERSION) ? DIGEST_SIZE + 2 * sizeof(int64_t) : 0;
+    for (uint64_t i = 0; i < count; i++) {
+        char* path = cursor + blob_size;
+        char* terminator = (path < end) ? memchr(path, '\0', (size_t)(end - path)) : NULL;
+        if (terminator == NULL) {
+            printf("vcs: error: %s is truncated\n", STAGE_FILE);
+            return 0;
+        }
+        if (blob_size > 0) {
+            int64_t start_byte;
+            int64_t end_byte;
+            memcpy(&start_byte, cursor + DIGEST_SIZE, sizeof(int64_t));
+            memcpy(&end_byte, cursor + DIGEST_SIZE + sizeof(int64_t), sizeof(int64_t));
+            stage_add(stage, path, 0, (start_byte >= 0) ? (const uint8_t*)cursor : NULL, start_byte, end_byte);
+        } else {
+            stage_add(stage, path, 0, NULL, -1, -1);
+        }
+        cursor = terminator + 1;
+    }
+    return 1;
+}
+
+/**
+ * @brief Loads the stage into the arena.
+ *
+ * @param arena The arena that holds the stage.
+ * @return A pointer to the loaded Stage, or NULL if it could not be read.
+ */
+Stage* stage_load(Arena* arena) {
+    Stage* stage = (Stage*)arena_alloc(arena, sizeof(Stage));
+    if (stage == NULL)
+        return stage;
+    stage->count = 0;
+    stage->capacity = 0;
+    stage->paths = NULL;
+    stage->digests = NULL;
+    stage->start_bytes = NULL;
+    stage->end_bytes = NULL;
+    stage->slots = NULL;
+    stage->slot_count = 0;
+    stage->arena = arena;
+    stage_reserve(stage, STAGE_MIN_CAPACITY);
+
+    int loaded;
+    if (file_exists(STAGE_FILE) == 0 && file_exists(LEGACY_STAGE_FILE) == 1) {
+        loaded = stage_convert_legacy(stage);
+    } else {
+        loaded = stage_read(stage);
+    }
+    return loaded ? stage : NULL;
+}
+
+/**
+ * @brief Finds the entry of a staged path.
+ *
+ * @param stage The stage.
+ * @param path The path.
+ * @return The index of the entry, or -1 if the path is not staged.
+ */
+long stage_find(const Stage* stage, const char* path) {
+    return (long)stage->slots[stage_slot(stage, path)] - 1;
+}
+
+/**
+ * @brief Stages a copy of a path with the blob its content was stored as.
+ *
+ * @param stage The stage.
+ * @param path The path.
+ * @param blob The stored blob.
+ * @return STAGE_ADDED for a new path, STAGE_UPDATED if the staged blob changed, STAGE_UNCHANGED otherwise.
+ */
+int stage_set(Stage* stage, const char* path, const Blob* blob) {
+    uint8_t digest[DIGEST_SIZE];
+    if (hex_to_digest(blob->digest, digest) == 0) {
+        return stage_add(stage, (char*)path, 1, NULL, -1, -1);
+    }
+    return stage_add(stage, (char*)path, 1, digest, blob->start_byte, blob->end_byte);
+}
+
+/**
+ * @brief Removes every path from the stage.
+ *
+ * @param stage The stage.
+ */
+void stage_clear(Stage* stage) {
+    stage->count = 0;
+    memset(stage->slots, 0, stage->slot_count * sizeof(uint32_t));
+}
+
+/**
+ * @brief Writes the stage back to the stage index.
+ *
+ * @param stage The stage.
+ * @return 1 if the index was written successfully, 0 otherwise.
+ */
+int stage_save(const Stage* stage) {
+    return stage_write(STAGE_FILE, stage);
+}
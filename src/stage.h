@@ -0,0 +1,53 @@
+# ifndef __STAGE_H__
+# define __STAGE_H__
+
+# include <stddef.h>
+# include <stdint.h>
+
+# include "arena.h"
+# include "blobs.h"
+# include "sha256.h"
+
+/// Format
+# define STAGE_MAGIC "VCSS"
+# define STAGE_VERSION 2
+# define STAGE_VERSION_PATHS 1
+# define STAGE_HEADER_SIZE 16
+
+/// Results
+# define STAGE_UNCHANGED 0
+# define STAGE_ADDED 1
+# define STAGE_UPDATED 2
+
+typedef struct stage Stage;
+
+/**
+ * Staged paths in the order they were added, with the blob each one was
+ * stored as when it was added, and an open-addressing hash set over the
+ * paths for constant-time membership checks. A slot holds the index of its
+ * path plus one, and 0 marks an empty slot. Paths staged before adds stored
+ * content have a start byte of -1 and are stored at commit time. Everything
+ * is allocated from the arena of the command.
+ */
+struct stage {
+    size_t count;
+    size_t capacity;
+    char** paths;
+    uint8_t (*digests)[DIGEST_SIZE];
+    int64_t* start_bytes;
+    int64_t* end_bytes;
+    uint32_t* slots;
+    size_t slot_count;
+    Arena* arena;
+};
+
+// function prototypes
+int stage_create(const char* path);
+Stage* stage_load(Arena* arena);
+void stage_reserve(Stage* stage, size_t capacity);
+long stage_find(const Stage* stage, const char* path);
+int stage_set(Stage* stage, const char* path, const Blob* blob);
+void stage_clear(Stage* stage);
+int stage_save(const Stage* stage);
+
+# endif
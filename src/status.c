@@ -0,0 +1,355 @@
+/**
+ * @file status.c
+ * @brief Working tree status for the VCS (Version Control System).
+ *
+ * Status compares three versions of every tracked path: the last committed
+ * version, the stage and the working tree. Commits only hold the files staged
+ * for them, so the committed version of a path is its newest entry across
+ * every commit. The stage is compared with the committed version by digest. Working files are compared with the staged blob, or with the
+ * committed blob for paths that are not staged. A pool of threads stats the
+ * working files and hashes only those whose stat data does not match the
+ * stat cache; the digests it computes are written back to the cache, so the
+ * next status does not hash them again. When a monitor is running, files it
+ * did not see change since the last status are not even stat'ed: their
+ * cached digest is still the digest of their content. Untracked files come
+ * from a walk of the working tree, merged against the sorted tracked paths.
+ */
+# include <stdio.h>
+# include <stdlib.h>
+# include <string.h>
+# include <unistd.h>
+# include <pthread.h>
+# include <sys/stat.h>
+
+# include "sha256.h"
+# include "walk.h"
+# include "status.h"
+
+typedef struct status_entry StatusEntry;
+typedef struct status_work StatusWork;
+
+/**
+ * One tracked path. Expected is the digest the working file should have,
+ * or NULL when it is unknown because the path was stored before digests.
+ */
+struct status_entry {
+    const char* path;
+    const uint8_t* expected;
+    int staged;
+    int working;
+    int hashed;
+    struct stat st;
+    uint8_t digest[DIGEST_SIZE];
+};
+
+/**
+ * Entries shared by the checking threads, which take them in batches.
+ */
+struct status_work {
+    pthread_mutex_t lock;
+    StatusEntry* entries;
+    size_t count;
+    size_t next;
+    const StatCache* cache;
+    const MonitorChanges* changes;
+};
+
+/**
+ * @brief Compares one working file with the digest it should have.
+ *
+ * @param entry The entry to check.
+ * @param cache The stat cache, which is only read.
+ * @param changes The paths changed since the last status, or NULL without a monitor.
+ */
+static void status_check(StatusEntry* entry, const StatCache* cache, const MonitorChanges* changes) {
+    // the cache is exact for files the monitor saw no change to
+    if (changes != NULL && entry->expected != NULL && !monitor_changed(changes, entry->path)) {
+        const uint8_t* digest = stat_cache_digest(cache, entry->path);
+        if (digest != NULL) {
+            if (memcmp(digest, entry->expected, DIGEST_SIZE) != 0) {
+                entry->working = STATUS_MODIFIED;
+            }
+            return;
+        }
+    }
+
+    if (stat(entry->path, &entry->st) != 0) {
+        entry->working = STATUS_DELETED;
+        return;
+    }
+    if (entry->expected == NULL) {
+        return;
+    }
+
+    // only files whose stat data changed are read
+    const uint8_t* digest = stat_cache_lookup(cache, entry->path, &entry->st);
+    if (digest == NULL) {
+        if (sha256_file(entry->path, entry->digest) == 0) {
+            entry->working = STATUS_DELETED;
+            return;
+        }
+        entry->hashed = 1;
+        digest = entry->digest;
+    }
+    if (memcmp(digest, entry->expected, DIGEST_SIZE) != 0) {
+        entry->working = STATUS_MODIFIED;
+    }
+}
+
+/**
+ * @brief Checks batches of entries until none are left.
+ *
+ * @param argument The shared work.
+ * @return NULL.
+ */
+static void* status_worker(void* argument) {
+    StatusWork* work = (StatusWork*)argument;
+    for (;;) {
+        pthread_mutex_lock(&work->lock);
+        size_t start = work->next;
+        work->next = (start + STATUS_BATCH_SIZE < work->count) ? start + STATUS_BATCH_SIZE : work->count;
+        size_t end = work->next;
+        pthread_mutex_unlock(&work->lock);
+
+        if (start == end) {
+            return NULL;
+        }
+        for (size_t i = start; i < end; i++) {
+            status_check(&work->entries[i], work->cache, work->changes);
+        }
+    }
+}
+
+/**
+ * @brief Checks every entry, in parallel when there are enough of them.
+ *
+ * @param entries The entries.
+ * @param count The number of entries.
+ * @param cache The stat cache.
+ * @param changes The paths changed since the last status, or NULL without a monitor.
+ */
+static void status_check_all(StatusEntry* entries, size_t count, const StatCache* cache, const MonitorChanges* changes) {
+    StatusWork work;
+    pthread_mutex_init(&work.lock, NULL);
+    work.entries = entries;
+    work.count = count;
+    work.next = 0;
+    work.cache = cache;
+    work.changes = changes;
+
+    long processors = sysconf(_SC_NPROCESSORS_ONLN);
+    size_t thread_count = (processors < 1) ? 1 : (size_t)processors;
+    if (thread_count > STATUS_MAX_THREADS) {
+        thread_count = STATUS_MAX_THREADS;
+    }
+    if (thread_count > count / STATUS_BATCH_SIZE) {
+        thread_count = count / STATUS_BATCH_SIZE;
+    }
+
+    // the calling thread works too, and finishes alone if no thread starts
+    pthread_t threads[STATUS_MAX_THREADS];
+    size_t started = 0;
+    while (started + 1 < thread_count && pthread_create(&threads[started], NULL, status_worker, &work) == 0) {
+        started++;
+    }
+    status_worker(&work);
+    for (size_t i = 0; i < started; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    pthread_mutex_destroy(&work.lock);
+}
+
+/**
+ * @brief Hashes a path with FNV-1a.
+ *
+ * @param path The path.
+ * @return The hash.
+ */
+static uint64_t status_hash(const char* path) {
+    uint64_t hash = 14695981039346656037ULL;
+    for (const unsigned char* c = (const unsigned char*)path; *c != '\0'; c++) {
+        hash ^= *c;
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+/**
+ * @brief Finds the slot of a path among the entries, or the empty slot where it would go.
+ *
+ * @param entries The entries.
+ * @param slots The slots, holding an entry index plus one or 0 when empty.
+ * @param slot_count The number of slots, a power of two.
+ * @param path The path.
+ * @return The slot position.
+ */
+static size_t status_slot(const StatusEntry* entries, const uint32_t* slots, size_t slot_count, const char* path) {
+    size_t mask = slot_count - 1;
+    for (size_t i = (size_t)status_hash(path) & mask;; i = (i + 1) & mask) {
+        uint32_t slot = slots[i];
+        if (slot == 0 || strcmp(entries[slot - 1].path, path) == 0) {
+            return i;
+        }
+    }
+}
+
+/**
+ * @brief Orders entries by path, for qsort.
+ */
+static int status_compare(const void* a, const void* b) {
+    return strcmp(((const StatusEntry*)a)->path, ((const StatusEntry*)b)->path);
+}
+
+/**
+ * @brief Prints the name of a state followed by a path.
+ *
+ * @param state The state.
+ * @param path The path.
+ */
+static void status_line(int state, const char* path) {
+    const char* label = (state == STATUS_NEW) ? "new file:" : (state == STATUS_DELETED) ? "deleted:" : "modified:";
+    printf("\t%-12s%s\n", label, path);
+}
+
+/**
+ * @brief Prints the differences between the committed files, the stage and the working tree.
+ *
+ * @param head The commit table holding every commit, oldest first.
+ * @param stage The stage.
+ * @param cache The stat cache, refreshed with the digests of files that had to be read.
+ * @param changes The paths changed since the last status, or NULL without a monitor.
+ * @return 1 on success, 0 otherwise.
+ */
+int status_print(const CommitTable* head, const Stage* stage, StatCache* cache, const MonitorChanges* changes) {
+    Arena* arena = cache->arena;
+    const FileTable* files = &head->files;
+
+    size_t capacity = files->count + stage->count;
+    size_t slot_count = 16;
+    while (slot_count < files->count * 2) {
+        slot_count *= 2;
+    }
+    StatusEntry* entries = (StatusEntry*)arena_alloc(arena, (capacity + 1) * sizeof(StatusEntry));
+    uint8_t (*head_digests)[DIGEST_SIZE] = arena_alloc(arena, (files->count + 1) * DIGEST_SIZE);
+    uint32_t* slots = (uint32_t*)arena_alloc(arena, slot_count * sizeof(uint32_t));
+    char* seen = (char*)arena_alloc(arena, stage->count + 1);
+    if (entries == NULL || head_digests == NULL || slots == NULL || seen == NULL) {
+        printf("vcs: error: could not allocate memory for status\n");
+        return 0;
+    }
+    memset(entries, 0, capacity * sizeof(StatusEntry));
+    memset(slots, 0, slot_count * sizeof(uint32_t));
+    memset(seen, 0, stage->count);
+
+    // committed paths at their newest version, compared with their staged version if they have one
+    size_t count = 0;
+    for (size_t commit = head->count; commit-- > 0;) {
+        size_t start = head->file_starts[commit];
+        for (size_t row = start; row < start + head->file_counts[commit]; row++) {
+            size_t slot = status_slot(entries, slots, slot_count, files->paths[row]);
+            if (slots[slot] != 0) {
+                continue;
+            }
+            slots[slot] = (uint32_t)(count + 1);
+
+            const char* digest = files->digests[row];
+            StatusEntry* entry = &entries[count];
+            entry->path = files->paths[row];
+            if (digest != NULL && hex_to_digest(digest, head_digests[count]) == 1) {
+                entry->expected = head_digests[count];
+            }
+            count++;
+
+            long staged = stage_find(stage, entry->path);
+            if (staged >= 0) {
+                seen[staged] = 1;
+                const uint8_t* staged_digest = (stage->start_bytes[staged] >= 0) ? stage->digests[staged] : NULL;
+                if (staged_digest == NULL || entry->expected == NULL || memcmp(staged_digest, entry->expected, DIGEST_SIZE) != 0) {
+                    entry->staged = STATUS_MODIFIED;
+                }
+                entry->expected = staged_digest;
+            }
+        }
+    }
+
+    // staged paths that were never committed
+    for (size_t i = 0; i < stage->count; i++) {
+        if (!seen[i]) {
+            StatusEntry* entry = &entries[count++];
+            entry->path = stage->paths[i];
+            entry->staged = STATUS_NEW;
+            entry->expected = (stage->start_bytes[i] >= 0) ? stage->digests[i] : NULL;
+        }
+    }
+
+    status_check_all(entries, count, cache, changes);
+    qsort(entries, count, sizeof(StatusEntry), status_compare);
+
+    // remember the digests of files that had to be read, and forget deleted files
+    int refreshed = 0;
+    for (size_t i = 0; i < count; i++) {
+        if (entries[i].hashed) {
+            stat_cache_update(cache, entries[i].path, &entries[i].st, entries[i].digest);
+            refreshed = 1;
+        } else if (entries[i].working == STATUS_DELETED && stat_cache_remove(cache, entries[i].path)) {
+            refreshed = 1;
+        }
+    }
+    int saved = refreshed ? stat_cache_save(cache) : 1;
+
+    // the next status may skip what did not change from here on, once the cache holds every digest
+    if (changes != NULL && saved) {
+        monitor_save_token(changes);
+    }
+
+    if (head->count > 0) {
+        printf("On commit %s\n", head->hashes[head->count - 1]);
+    } else {
+        printf("No commits yet\n");
+    }
+
+    int clean = 1;
+    for (int section = 0; section < 2; section++) {
+        int printed = 0;
+        for (size_t i = 0; i < count; i++) {
+            int state = (section == 0) ? entries[i].staged : entries[i].working;
+            if (state == STATUS_CLEAN) {
+                continue;
+            }
+            if (!printed) {
+                printf("\n%s\n", (section == 0) ? "Changes to be committed:" : "Changes not staged for commit:");
+                printed = 1;
+            }
+            status_line(state, entries[i].path);
+            clean = 0;
+        }
+    }
+
+    // files in the working tree that are not tracked, merged against the sorted entries
+    size_t found;
+    char** paths = walk_directory(".", arena, &found);
+    if (paths == NULL) {
+        return 0;
+    }
+    int printed = 0;
+    for (size_t i = 0, j = 0; i < found; i++) {
+        while (j < count && strcmp(entries[j].path, paths[i]) < 0) {
+            j++;
+        }
+        if (j < count && strcmp(entries[j].path, paths[i]) == 0) {
+            continue;
+        }
+        if (!printed) {
+            printf("\nUntracked files:\n");
+            printed = 1;
+        }
+        printf("\t%s\n", paths[i]);
+        clean = 0;
+    }
+
+    if (clean) {
+        printf("\nnothing to commit, working tree clean\n");
+    }
+    printf("\n");
+    return 1;
+}
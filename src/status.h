@@ -0,0 +1,22 @@
+# ifndef __STATUS_H__
+# define __STATUS_H__
+
+# include "cache.h"
+# include "data_structures.h"
+# include "monitor.h"
+# include "stage.h"
+
+/// Settings
+# define STATUS_MAX_THREADS 8
+# define STATUS_BATCH_SIZE 256
+
+/// States
+# define STATUS_CLEAN 0
+# define STATUS_NEW 1
+# define STATUS_MODIFIED 2
+# define STATUS_DELETED 3
+
+// function prototypes
+int status_print(const CommitTable* head, const Stage* stage, StatCache* cache, const MonitorChanges* changes);
+
+# endif
@@ -0,0 +1,243 @@
+/**
+ * @file tokenizer.c
+ * @brief Record tokenizer for the VCS (Version Control System).
+ *
+ * Commit file lists and stage lines have no length limit. The tokenizer
+ * splits a buffer in place in a single forward pass, and the line reader
+ * streams a file one line at a time through a buffer that grows as needed,
+ * so parsing stays linear in the size of the input.
+ */
+# include <stdio.h>
+# include <stdlib.h>
+# include <string.h>
+
+# include "files.h"
+# include "sha256.h"
+# include "tokenizer.h"
+
+/**
+ * @brief Starts tokenizing a buffer.
+ *
+ * @param tokenizer The tokenizer.
+ * @param data The buffer, followed by a NUL terminator.
+ * @param size The number of bytes in data, not counting the terminator.
+ */
+void tokenizer_init(Tokenizer* tokenizer, char* data, size_t size) {
+    tokenizer->cursor = data;
+    tokenizer->end = data + size;
+}
+
+/**
+ * @brief Terminates the next token in place and moves the cursor past its delimiter.
+ *
+ * @param tokenizer The tokenizer.
+ * @param delimiter The byte that ends the token.
+ * @param length If not NULL, receives the length of the token.
+ * @return The token, or NULL if the buffer is exhausted.
+ */
+char* tokenizer_next(Tokenizer* tokenizer, char delimiter, size_t* length) {
+    char* token = tokenizer->cursor;
+    if (token >= tokenizer->end) {
+        return NULL;
+    }
+
+    char* found = memchr(token, delimiter, (size_t)(tokenizer->end - token));
+    if (found == NULL) {
+        // the last token is already terminated
+        found = tokenizer->end;
+        tokenizer->cursor = tokenizer->end;
+    } else {
+        *found = '\0';
+        tokenizer->cursor = found + 1;
+    }
+
+    if (length != NULL) {
+        *length = (size_t)(found - token);
+    }
+    return token;
+}
+
+/**
+ * @brief Terminates the next field of a file entry in place, undoing path escapes.
+ *
+ * A field ends at a space, and the entry ends at a comma; a backslash
+ * escapes a space, a comma or a backslash, and a backslash before n stands
+ * for a newline. Unescaping only shortens the field, so it is rewritten in
+ * place. Any other backslash is kept, as written by lists that predate
+ * escapes.
+ *
+ * @param tokenizer The tokenizer over the file list.
+ * @param last Set to 1 if the field ends the entry.
+ * @return The field, possibly empty.
+ */
+static char* tokenizer_field(Tokenizer* tokenizer, int* last) {
+    char* field = tokenizer->cursor;
+    char* read = field;
+    char* write = field;
+    char* end = tokenizer->end;
+
+    *last = 1;
+    while (read < end) {
+        char c = *read++;
+        if (c == '\\' && read < end && (*read == ' ' || *read == ',' || *read == '\\' || *read == 'n')) {
+            c = (*read == 'n') ? '\n' : *read;
+            read++;
+        } else if (c == ' ') {
+            *last = 0;
+            break;
+        } else if (c == ',') {
+            // the separator between entries is ", "
+            if (read < end && *read == ' ') {
+                read++;
+            }
+            break;
+        }
+        *write++ = c;
+    }
+    *write = '\0';
+    tokenizer->cursor = read;
+    return field;
+}
+
+/**
+ * @brief Tells whether a field is a hexadecimal digest.
+ *
+ * @param field The field.
+ * @return 1 if the field has DIGEST_HEX_SIZE - 1 hexadecimal digits, 0 otherwise.
+ */
+static int tokenizer_is_digest(const char* field) {
+    size_t length = strlen(field);
+    return (length == DIGEST_HEX_SIZE - 1) && (strspn(field, "0123456789abcdef") == length);
+}
+
+/**
+ * @brief Parses a byte offset field.
+ *
+ * @param field The field.
+ * @param value Receives the offset.
+ * @return 1 if the whole field is a number, 0 otherwise.
+ */
+static int tokenizer_offset(const char* field, int64_t* value) {
+    char* rest;
+    *value = strtoll(field, &rest, 10);
+    return (*field != '\0' && *rest == '\0');
+}
+
+/**
+ * @brief Parses the next entry of a commit file list.
+ *
+ * Entries are "path digest start end" and are separated by ", "; entries
+ * written before the blob store existed have no digest and are
+ * "path start end". Spaces, commas and backslashes in paths are escaped
+ * with a backslash, as tokenizer_write_path writes them.
+ *
+ * @param tokenizer The tokenizer over the file list.
+ * @param entry Receives the entry.
+ * @return 1 if an entry was parsed, 0 at the end of the list, -1 if the entry is malformed.
+ */
+int tokenizer_next_entry(Tokenizer* tokenizer, FileEntry* entry) {
+    if (tokenizer->cursor >= tokenizer->end) {
+        return 0;
+    }
+
+    // collect the non-empty fields of the entry
+    char* fields[4];
+    int count = 0;
+    int last = 0;
+    while (!last) {
+        char* field = tokenizer_field(tokenizer, &last);
+        if (*field == '\0') {
+            continue;
+        }
+        if (count == 4) {
+            return -1;
+        }
+        fields[count++] = field;
+    }
+    if (count < 3 || (count == 4 && !tokenizer_is_digest(fields[1]))) {
+        return -1;
+    }
+
+    entry->path = fields[0];
+    entry->digest = (count == 4) ? fields[1] : NULL;
+    if (!tokenizer_offset(fields[count - 2], &entry->start_byte) || !tokenizer_offset(fields[count - 1], &entry->end_byte)) {
+        return -1;
+    }
+    return 1;
+}
+
+/**
+ * @brief Writes a path as a field of a commit file list, escaping the bytes that end fields.
+ *
+ * @param file The file to write to.
+ * @param path The path.
+ * @return 1 if the path was written successfully, 0 otherwise.
+ */
+int tokenizer_write_path(FILE* file, const char* path) {
+    for (const char* c = path; *c != '\0'; c++) {
+        int written;
+        if (*c == ' ' || *c == ',' || *c == '\\') {
+            written = (fputc('\\', file) != EOF) && (fputc(*c, file) != EOF);
+        } else if (*c == '\n') {
+            written = (fputs("\\n", file) != EOF);
+        } else {
+            written = (fputc(*c, file) != EOF);
+        }
+        if (!written) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/**
+ * @brief Opens a file for reading line by line.
+ *
+ * @param reader The line reader.
+ * @param path The path of the file.
+ * @return 1 if the file was opened, 0 otherwise.
+ */
+int line_reader_open(LineReader* reader, const char* path) {
+    reader->buffer = NULL;
+    reader->capacity = 0;
+    reader->file = open_file(path, "r");
+    return (reader->file != NULL);
+}
+
+/**
+ * @brief Reads the next line, without its newline.
+ *
+ * The line stays valid until the next call or until the reader is closed.
+ *
+ * @param reader The line reader.
+ * @param length If not NULL, receives the length of the line.
+ * @return The line, or NULL at the end of the file.
+ */
+char* line_reader_next(LineReader* reader, size_t* length) {
+    ssize_t read = getline(&reader->buffer, &reader->capacity, reader->file);
+    if (read < 0) {
+        return NULL;
+    }
+    if (read > 0 && reader->buffer[read - 1] == '\n') {
+        reader->buffer[--read] = '\0';
+    }
+    if (length != NULL) {
+        *length = (size_t)read;
+    }
+    return reader->buffer;
+}
+
+/**
+ * @brief Closes the file and frees the line buffer.
+ *
+ * @param reader The line reader.
+ */
+void line_reader_close(LineReader* reader) {
+    if (reader->file != NULL) {
+        fclose(reader->file);
+        reader->file = NULL;
+    }
+    free(reader->buffer);
+    reader->buffer = NULL;
+    reader->capacity = 0;
+}
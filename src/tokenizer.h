@@ -0,0 +1,51 @@
+# ifndef __TOKENIZER_H__
+# define __TOKENIZER_H__
+
+# include <stdio.h>
+# include <stddef.h>
+# include <stdint.h>
+
+typedef struct tokenizer Tokenizer;
+typedef struct file_entry FileEntry;
+typedef struct line_reader LineReader;
+
+/**
+ * Cursor over a buffer that is split in place. The byte at end must be a
+ * NUL terminator, so the last token is terminated without writing past it.
+ */
+struct tokenizer {
+    char* cursor;
+    char* end;
+};
+
+/**
+ * One file entry of a commit, pointing into the tokenized buffer. The
+ * digest is NULL for entries written before the blob store existed.
+ */
+struct file_entry {
+    char* path;
+    char* digest;
+    int64_t start_byte;
+    int64_t end_byte;
+};
+
+/**
+ * Reads a file line by line into a buffer that grows with the longest line.
+ */
+struct line_reader {
+    FILE* file;
+    char* buffer;
+    size_t capacity;
+};
+
+// function prototypes
+void tokenizer_init(Tokenizer* tokenizer, char* data, size_t size);
+char* tokenizer_next(Tokenizer* tokenizer, char delimiter, size_t* length);
+int tokenizer_next_entry(Tokenizer* tokenizer, FileEntry* entry);
+int tokenizer_write_path(FILE* file, const char* path);
+
+int line_reader_open(LineReader* reader, const char* path);
+char* line_reader_next(LineReader* reader, size_t* length);
+void line_reader_close(LineReader* reader);
+
+# endif
@@ -0,0 +1,324 @@
+/**
+ * @file upgrade.c
+ * @brief Conversion of repositories written with 32-bit offsets for the VCS (Version Control System).
+ *
+ * Older versions stored byte offsets as int, so every offset past 2 GiB was
+ * written modulo 2^32. Because the contents and commits files are append-only,
+ * the true offsets are recovered by unwrapping each stored value to the
+ * smallest offset, not below the previous one, with the same low 32 bits.
+ *
+ * The conversion runs automatically when a version 1 metadata index is opened.
+ * Repositories that never crossed 2 GiB only get their version bumped. Larger
+ * ones get their blobs file, commits file and metadata index rewritten; the
+ * last two are swapped in through a marker file so an interrupted swap is
+ * finished on the next run.
+ */
+# include <stdio.h>
+# include <stdlib.h>
+# include <string.h>
+# include <inttypes.h>
+
+# include "validations.h"
+# include "files.h"
+# include "blobs.h"
+# include "metadata.h"
+# include "upgrade.h"
+# include "tokenizer.h"
+
+/**
+ * @brief Recovers a 64-bit offset from a value that may have been truncated to 32 bits.
+ *
+ * @param stored The stored value.
+ * @param floor The smallest possible true value.
+ * @return The smallest offset not below floor with the same low 32 bits as stored.
+ */
+int64_t upgrade_unwrap_offset(int64_t stored, int64_t floor) {
+    uint64_t low = (uint64_t)stored & 0xffffffffULL;
+    uint64_t candidate = ((uint64_t)floor & ~0xffffffffULL) | low;
+    if (candidate < (uint64_t)floor) {
+        candidate += 0x100000000ULL;
+    }
+    return (int64_t)candidate;
+}
+
+/**
+ * @brief Recovers the end of a byte range from its recovered start.
+ *
+ * @param stored_start The stored start value.
+ * @param stored_end The stored end value.
+ * @param start The recovered start.
+ * @return The recovered end.
+ */
+static int64_t unwrap_end(int64_t stored_start, int64_t stored_end, int64_t start) {
+    uint64_t span = ((uint64_t)stored_end - (uint64_t)stored_start) & 0xffffffffULL;
+    return start + (int64_t)span;
+}
+
+/**
+ * @brief Rewrites the blobs file with recovered offsets.
+ *
+ * @param blobs Receives the recovered blobs, keyed by digest.
+ * @param changed Set to 1 if any offset changed.
+ * @return 1 on success, 0 otherwise.
+ */
+static int upgrade_blobs(BlobIndex* blobs, int* changed) {
+    FILE* blobs_file = fopen(BLOBS_FILE, "r");
+    if (blobs_file == NULL) {
+        return 1;
+    }
+    FILE* output = open_file(BLOBS_FILE ".tmp", "w");
+    if (output == NULL) {
+        fclose(blobs_file);
+        return 0;
+    }
+
+    // blobs are appended in order, so starts never decrease
+    char digest[DIGEST_HEX_SIZE];
+    int64_t stored_start;
+    int64_t stored_end;
+    int64_t floor = 0;
+    while (fscanf(blobs_file, "%64s %" SCNd64 " %" SCNd64, digest, &stored_start, &stored_end) == 3) {
+        int64_t start = upgrade_unwrap_offset(stored_start, floor);
+        int64_t end = unwrap_end(stored_start, stored_end, start);
+        if (start != stored_start || end != stored_end) {
+            *changed = 1;
+        }
+        floor = start;
+
+        fprintf(output, "%s %" PRId64 " %" PRId64 "\n", digest, start, end);
+        blob_index_insert(blobs, digest, start, end);
+    }
+
+    fclose(blobs_file);
+    return (fclose(output) == 0);
+}
+
+/**
+ * @brief Writes one commit file entry with recovered offsets.
+ *
+ * @param output The new commits file.
+ * @param entry The parsed entry.
+ * @param blobs The recovered blobs.
+ * @param legacy_floor The smallest possible offset of the next entry without a digest.
+ * @param changed Set to 1 if any offset changed.
+ */
+static void upgrade_file_entry(FILE* output, const FileEntry* entry, BlobIndex* blobs, int64_t* legacy_floor, int* changed) {
+    int64_t stored_start = entry->start_byte;
+    int64_t stored_end = entry->end_byte;
+    int64_t start;
+    int64_t end;
+
+    // entries with a digest take the recovered blob offsets
+    Blob* blob = (entry->digest != NULL) ? blob_index_find(blobs, entry->digest) : NULL;
+    if (blob != NULL) {
+        start = blob->start_byte;
+        end = blob->end_byte;
+    } else {
+        // entries written before the blob store were appended in commit order
+        start = upgrade_unwrap_offset(stored_start, *legacy_floor);
+        end = unwrap_end(stored_start, stored_end, start);
+        *legacy_floor = start;
+    }
+    if (start != stored_start || end != stored_end) {
+        *changed = 1;
+    }
+
+    tokenizer_write_path(output, entry->path);
+    if (entry->digest != NULL) {
+        fprintf(output, " %s %" PRId64 " %" PRId64, entry->digest, start, end);
+    } else {
+        fprintf(output, " %" PRId64 " %" PRId64, start, end);
+    }
+}
+
+/**
+ * @brief Rewrites the commits file with recovered offsets and builds the new metadata records.
+ *
+ * @param records The metadata records, updated in place with the new offsets and lengths.
+ * @param count The number of records.
+ * @param blobs The recovered blobs.
+ * @param changed Set to 1 if any offset changed.
+ * @return 1 on success, 0 otherwise.
+ */
+static int upgrade_commits(MetadataRecord* records, size_t count, BlobIndex* blobs, int* changed) {
+    FILE* commits_file = open_file(COMMITS_FILE, "r");
+    if (commits_file == NULL) {
+        return 0;
+    }
+    FILE* output = open_file(COMMITS_FILE ".tmp", "w");
+    if (output == NULL) {
+        fclose(commits_file);
+        return 0;
+    }
+
+    int ok = 1;
+    int64_t commit_floor = 0;
+    int64_t legacy_floor = 0;
+    for (size_t i = 0; i < count && ok; i++) {
+        // commits are appended in order, so offsets never decrease
+        int64_t stored_offset = (int64_t)records[i].offset;
+        int64_t offset = upgrade_unwrap_offset(stored_offset, commit_floor);
+        if (offset != stored_offset) {
+            *changed = 1;
+        }
+        commit_floor = offset;
+
+        // read the whole record
+        char* record = malloc((size_t)records[i].length + 1);
+        if (record == NULL) {
+            ok = 0;
+            break;
+        }
+        fseeko(commits_file, (off_t)offset, SEEK_SET);
+        size_t length = fread(record, 1, records[i].length, commits_file);
+        record[length] = '\0';
+
+        // hash and date lines are copied, the file list is rewritten
+        char* date = strchr(record, '\n');
+        char* files = (date != NULL) ? strchr(date + 1, '\n') : NULL;
+        char* message = (files != NULL) ? strchr(files + 1, '\n') : NULL;
+        if (message == NULL) {
+            printf("vcs: error: malformed commit at byte %" PRId64 " of %s\n", offset, COMMITS_FILE);
+            free(record);
+            ok = 0;
+            break;
+        }
+        *message = '\0';
+
+        int64_t new_offset = (int64_t)ftello(output);
+        fwrite(record, 1, (size_t)(files + 1 - record), output);
+
+        Tokenizer tokenizer;
+        tokenizer_init(&tokenizer, files + 1, (size_t)(message - files - 1));
+        FileEntry entry;
+        int first = 1;
+        int parsed;
+        while ((parsed = tokenizer_next_entry(&tokenizer, &entry)) == 1) {
+            if (!first) {
+                fprintf(output, ", ");
+            }
+            upgrade_file_entry(output, &entry, blobs, &legacy_floor, changed);
+            first = 0;
+        }
+        if (parsed < 0) {
+            printf("vcs: error: malformed file list in commit at byte %" PRId64 " of %s\n", offset, COMMITS_FILE);
+            free(record);
+            ok = 0;
+            break;
+        }
+        fprintf(output, "\n");
+        fwrite(message + 1, 1, length - (size_t)(message + 1 - record), output);
+        free(record);
+
+        records[i].offset = (uint64_t)new_offset;
+        records[i].length = (uint32_t)((int64_t)ftello(output) - new_offset);
+    }
+
+    fclose(commits_file);
+    if (fclose(output) != 0) {
+        ok = 0;
+    }
+    return ok;
+}
+
+/**
+ * @brief Writes a version 2 metadata index.
+ *
+ * @param path The path to write.
+ * @param records The records to write.
+ * @param count The number of records.
+ * @return 1 on success, 0 otherwise.
+ */
+static int write_metadata(const char* path, const MetadataRecord* records, size_t count) {
+    FILE* file = open_file(path, "wb");
+    if (file == NULL) {
+        return 0;
+    }
+    uint32_t version = METADATA_VERSION;
+    int ok = (fwrite(METADATA_MAGIC, 1, 4, file) == 4);
+    ok = ok && (fwrite(&version, sizeof(version), 1, file) == 1);
+    ok = ok && (fwrite(records, sizeof(MetadataRecord), count, file) == count);
+    if (fclose(file) != 0) {
+        ok = 0;
+    }
+    return ok;
+}
+
+/**
+ * @brief Finishes swapping in a rewritten commits file and metadata index.
+ *
+ * The marker file is the complete new metadata index; it is only created after
+ * the new commits file is complete, so finishing the swap is always safe.
+ *
+ * @return 1 on success, 0 otherwise.
+ */
+int upgrade_resume() {
+    if (file_exists(COMMITS_FILE ".tmp") == 1 && rename(COMMITS_FILE ".tmp", COMMITS_FILE) != 0) {
+        return 0;
+    }
+    if (rename(UPGRADE_FILE, METADATA_FILE) != 0) {
+        return 0;
+    }
+
+    // the commit index refers to metadata slots, which are unchanged
+    return 1;
+}
+
+/**
+ * @brief Converts a repository with a version 1 metadata index to 64-bit offsets.
+ *
+ * @return 1 on success, 0 otherwise.
+ */
+int upgrade_offsets() {
+    // read the version 1 records
+    size_t size;
+    char* data = read_file(METADATA_FILE, &size);
+    if (data == NULL) {
+        return 0;
+    }
+    size_t count = (size > METADATA_HEADER_SIZE) ? (size - METADATA_HEADER_SIZE) / sizeof(MetadataRecord) : 0;
+    MetadataRecord* records = malloc((count + 1) * sizeof(MetadataRecord));
+    if (records == NULL) {
+        free(data);
+        return 0;
+    }
+    memcpy(records, data + METADATA_HEADER_SIZE, count * sizeof(MetadataRecord));
+    free(data);
+
+    // recover blob offsets, then commit offsets
+    int changed = 0;
+    BlobIndex* blobs = blob_index_create();
+    int ok = (blobs != NULL) && upgrade_blobs(blobs, &changed) && upgrade_commits(records, count, blobs, &changed);
+    if (blobs != NULL) {
+        blob_index_destroy(blobs);
+    }
+
+    if (ok && changed == 0) {
+        // nothing crossed 2 GiB: the files are already correct
+        remove(BLOBS_FILE ".tmp");
+        remove(COMMITS_FILE ".tmp");
+        FILE* file = open_file(METADATA_FILE, "r+b");
+        uint32_t version = METADATA_VERSION;
+        ok = (file != NULL) && fseeko(file, 4, SEEK_SET) == 0 && fwrite(&version, sizeof(version), 1, file) == 1;
+        if (file != NULL && fclose(file) != 0) {
+            ok = 0;
+        }
+    } else if (ok) {
+        printf("vcs: converting repository to 64-bit offsets\n");
+        ok = write_metadata(METADATA_FILE ".tmp", records, count)
+             && (file_exists(BLOBS_FILE ".tmp") == 0 || rename(BLOBS_FILE ".tmp", BLOBS_FILE) == 0)
+             && rename(METADATA_FILE ".tmp", UPGRADE_FILE) == 0
+             && upgrade_resume();
+    }
+    free(records);
+
+    if (ok == 0) {
+        remove(BLOBS_FILE ".tmp");
+        remove(METADATA_FILE ".tmp");
+        if (file_exists(UPGRADE_FILE) == 0) {
+            remove(COMMITS_FILE ".tmp");
+        }
+        printf("vcs: error: could not convert repository to 64-bit offsets\n");
+    }
+    return ok;
+}
@@ -0,0 +1,11 @@
+# ifndef __UPGRADE_H__
+# define __UPGRADE_H__
+
+# include <stdint.h>
+
+// function prototypes
+int upgrade_resume();
+int upgrade_offsets();
+int64_t upgrade_unwrap_offset(int64_t stored, int64_t floor);
+
+# endif
@@ -11,39 +11,69 @@
 # include <time.h>
 # include <sys/stat.h>
 
+# include "sha256.h"
 # include "utils.h"
 
 /**
- * @brief Generates a random hexadecimal hash.
+ * @brief Computes the identifier of a commit from its contents.
  *
- * @return A dynamically allocated string containing the generated hash.
+ * The identifier is the SHA-256 digest of the parent identifier, the
+ * timestamp, the file manifest (path and blob digest of each file) and the
+ * message. Each commit therefore commits to its whole history, and the same
+ * inputs always produce the same identifier.
+ *
+ * @param parent The identifier of the parent commit, or NULL for the first commit.
+ * @param date The commit timestamp.
+ * @param files The file table of the commit.
+ * @param message The commit message.
+ * @return A dynamically allocated string containing the hexadecimal identifier.
  */
-char *hash() {
-    char *hash = malloc(41 * sizeof(char));
+char *commit_hash(const char *parent, const char *date, const FileTable *files, const char *message) {
+    char *hash = malloc(DIGEST_HEX_SIZE * sizeof(char));
     if (hash == NULL) {
         printf("Error allocating memory for hash\n");
         exit(EXIT_FAILURE);
     }
 
-    const char *hexChars = "0123456789ABCDEF";
-    srand(time(NULL));
+    Sha256Context context;
+    sha256_init(&context);
+
+    // header fields, one per line
+    sha256_update(&context, "parent ", 7);
+    if (parent != NULL) {
+        sha256_update(&context, parent, strlen(parent));
+    }
+    sha256_update(&context, "\ndate ", 6);
+    sha256_update(&context, date, strlen(date));
+    sha256_update(&context, "\n", 1);
 
-    for (int i = 0; i < 40; i++) {
-        hash[i] = hexChars[rand() % 16];
+    // manifest, one NUL-separated "path digest" entry per line
+    for (size_t i = 0; i < files->count; i++) {
+        sha256_update(&context, files->paths[i], strlen(files->paths[i]) + 1);
+        if (files->digests[i] != NULL) {
+            sha256_update(&context, files->digests[i], strlen(files->digests[i]));
+        }
+        sha256_update(&context, "\n", 1);
     }
-    hash[40] = '\0';
+
+    // message after a blank line
+    sha256_update(&context, "\n", 1);
+    sha256_update(&context, message, strlen(message));
+
+    uint8_t digest[DIGEST_SIZE];
+    sha256_final(&context, digest);
+    digest_to_hex(digest, hash);
 
     return hash;
 }
 
 /**
- * @brief Retrieves the current timestamp.
+ * @brief Formats a commit timestamp.
  *
- * @return A string representing the current timestamp.
+ * @param t The time to format.
+ * @return A string representing the timestamp.
  */
-char* timestamp() {
-    time_t t;
-    time(&t);
+char* timestamp(time_t t) {
     char *date = ctime(&t);
     date[strlen(date) - 1] = '\0';
     return date;
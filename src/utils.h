@@ -1,8 +1,12 @@
 # ifndef __UTILS_H__
 # define __UTILS_H__
 
-char* hash();
-char* timestamp();
+# include <time.h>
+
+# include "data_structures.h"
+
+char* commit_hash(const char* parent, const char* date, const FileTable* files, const char* message);
+char* timestamp(time_t t);
 void printInfo(const char* message);
 void printAlert(const char* message);
 void printWarning(const char* message);
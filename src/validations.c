@@ -9,6 +9,7 @@
 # include <stdlib.h>
 # include <string.h>
 # include <unistd.h>
+# include <sys/stat.h>
 
 # include "data_structures.h"
 # include "validations.h"
@@ -23,6 +24,17 @@ int directory_exists(const char *path) {
     return (access(path, F_OK) == 0);
 }
 
+/**
+ * @brief Checks if a path is a directory.
+ *
+ * @param path The path.
+ * @return 1 if the path is a directory, 0 otherwise.
+ */
+int is_directory(const char *path) {
+    struct stat st;
+    return (stat(path, &st) == 0 && S_ISDIR(st.st_mode));
+}
+
 /**
  * @brief Checks if a file exists.
  *
@@ -51,7 +63,7 @@ int validate_directory(const char *path) {
         printf("vcs: error: .vcs/commit file not found\n");
         return 0;
     }
-    if (file_exists(STAGE_FILE) == 0) {
+    if (file_exists(STAGE_FILE) == 0 && file_exists(LEGACY_STAGE_FILE) == 0) {
         printf("vcs: error: .vcs/stage file not found\n");
         return 0;
     }
@@ -59,7 +71,7 @@ int validate_directory(const char *path) {
         printf("vcs: error: .vcs/contents file not found\n");
         return 0;
     }
-    if (file_exists(METADATA_FILE) == 0) {
+    if (file_exists(METADATA_FILE) == 0 && file_exists(LEGACY_METADATA_FILE) == 0) {
         printf("vcs: error: .vcs/metadata file not found\n");
         return 0;
     }
@@ -80,40 +92,11 @@ int file_is_empty(const char *path) {
         return 0;
     }
     
-    fseek(file, 0, SEEK_END);
-    int size = ftell(file);
+    fseeko(file, 0, SEEK_END);
+    off_t size = ftello(file);
 
     // close file
     fclose(file);
 
     return (size == 0);
 }
-
-/**
- * @brief Checks if a path is staged.
- *
- * @param path The path to the file.
- * @return 1 if the path is staged, 0 otherwise.
- */
-int path_is_staged(const char *path) {
-    FILE *file = fopen(STAGE_FILE, "r");
-    if (file == NULL) {
-        printf("vcs: error: .vcs/stage file not found\n");
-        return 0;
-    }
-
-    // read file line by line
-    char line[256];
-    while (fgets(line, sizeof(line), file)) {
-        // Remove the trailing newline character
-        line[strcspn(line, "\n")] = '\0';
-
-        if (strcmp(path, line) == 0) {
-            fclose(file);
-            return 1;
-        }
-    }
-
-    fclose(file);
-    return 0;
-}
\ No newline at end of file
@@ -4,15 +4,25 @@
 /// Paths
 # define VCS_DIRECTORY ".vcs"
 # define COMMITS_FILE ".vcs/commits.txt"
-# define STAGE_FILE ".vcs/stage.txt"
+# define STAGE_FILE ".vcs/stage.idx"
+# define LEGACY_STAGE_FILE ".vcs/stage.txt"
 # define CONTENTS_FILE ".vcs/contents.txt"
-# define METADATA_FILE ".vcs/metadata.txt"
+# define METADATA_FILE ".vcs/metadata.idx"
+# define LEGACY_METADATA_FILE ".vcs/metadata.txt"
+# define BLOBS_FILE ".vcs/blobs.txt"
+# define CONFIG_FILE ".vcs/config.txt"
+# define COMMIT_INDEX_FILE ".vcs/commits.idx"
+# define UPGRADE_FILE ".vcs/metadata.upgrade"
+# define CACHE_FILE ".vcs/cache.idx"
+# define MONITOR_SOCKET ".vcs/monitor.sock"
+# define MONITOR_TOKEN_FILE ".vcs/monitor.token"
+# define JOURNAL_FILE ".vcs/journal.idx"
 
 /// FUNCTIONS
 int directory_exists(const char *path);
 int file_exists(const char *path);
+int is_directory(const char *path);
 int validate_directory(const char *path);
 int file_is_empty(const char *path);
-int path_is_staged(const char *path);
 
 # endif
\ No newline at end of file
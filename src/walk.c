@@ -0,0 +1,390 @@
+/**
+ * @file walk.c
+ * @brief Parallel directory walk for the VCS (Version Control System).
+ *
+ * Directories waiting to be listed sit in a shared queue that a pool of
+ * threads drains. Each thread lists one directory at a time, keeps the
+ * regular files it finds in its own arena and pushes the subdirectories back
+ * onto the queue in one batch. The walk is over once the queue is empty and
+ * no thread is listing a directory. On Linux directories are read with
+ * getdents64 into a large buffer; other systems use readdir.
+ */
+# define _GNU_SOURCE
+
+# include <stdio.h>
+# include <stdlib.h>
+# include <string.h>
+# include <fcntl.h>
+# include <unistd.h>
+# include <dirent.h>
+# include <pthread.h>
+# include <sys/stat.h>
+# ifdef __linux__
+# include <stdint.h>
+# include <sys/syscall.h>
+# endif
+
+# include "validations.h"
+# include "walk.h"
+
+typedef struct walk_queue WalkQueue;
+typedef struct walk_worker WalkWorker;
+
+/**
+ * Directories waiting to be listed. Active counts the directories that are
+ * being listed, which may still push more.
+ */
+struct walk_queue {
+    pthread_mutex_t lock;
+    pthread_cond_t ready;
+    char** directories;
+    size_t count;
+    size_t capacity;
+    size_t active;
+    int failed;
+};
+
+/**
+ * One walking thread and the files it found. Paths and queued directory
+ * names live in the arena of the thread.
+ */
+struct walk_worker {
+    pthread_t thread;
+    WalkQueue* queue;
+    Arena* arena;
+    char** paths;
+    size_t count;
+    size_t capacity;
+    char** subdirectories;
+    size_t subdirectory_count;
+    size_t subdirectory_capacity;
+};
+
+# ifdef __linux__
+struct linux_dirent64 {
+    uint64_t d_ino;
+    int64_t d_off;
+    unsigned short d_reclen;
+    unsigned char d_type;
+    char d_name[];
+};
+# endif
+
+/**
+ * @brief Appends a pointer to a growable array.
+ *
+ * @param array The array.
+ * @param count The number of elements in use.
+ * @param capacity The number of allocated elements.
+ * @param value The pointer to append.
+ * @return 1 on success, 0 on allocation failure.
+ */
+static int walk_push(char*** array, size_t* count, size_t* capacity, char* value) {
+    if (*count == *capacity) {
+        size_t grown = (*capacity == 0) ? 64 : *capacity * 2;
+        char** resized = realloc(*array, grown * sizeof(char*));
+        if (resized == NULL) {
+            return 0;
+        }
+        *array = resized;
+        *capacity = grown;
+    }
+    (*array)[(*count)++] = value;
+    return 1;
+}
+
+/**
+ * @brief Joins a directory and an entry name in the arena of a worker.
+ *
+ * Entries of "." are named without a prefix.
+ *
+ * @param arena The arena.
+ * @param directory The directory.
+ * @param name The entry name.
+ * @return The joined path, or NULL on allocation failure.
+ */
+static char* walk_join(Arena* arena, const char* directory, const char* name) {
+    size_t directory_length = (strcmp(directory, ".") == 0) ? 0 : strlen(directory);
+    size_t name_length = strlen(name);
+    int separator = (directory_length > 0 && directory[directory_length - 1] != '/');
+
+    char* path = (char*)arena_alloc(arena, directory_length + separator + name_length + 1);
+    if (path == NULL) {
+        return NULL;
+    }
+    memcpy(path, directory, directory_length);
+    if (separator) {
+        path[directory_length] = '/';
+    }
+    memcpy(path + directory_length + separator, name, name_length + 1);
+    return path;
+}
+
+/**
+ * @brief Records one directory entry as a file or a subdirectory to walk.
+ *
+ * Symbolic links and special files are skipped, as is the repository directory.
+ *
+ * @param worker The worker.
+ * @param fd The open directory.
+ * @param directory The directory path.
+ * @param name The entry name.
+ * @param type The entry type, or DT_UNKNOWN if the file system does not report it.
+ * @return 1 on success, 0 on allocation failure.
+ */
+static int walk_entry(WalkWorker* worker, int fd, const char* directory, const char* name, unsigned char type) {
+    if (strcmp(name, ".") == 0 || strcmp(name, "..") == 0 || strcmp(name, VCS_DIRECTORY) == 0) {
+        return 1;
+    }
+
+    if (type == DT_UNKNOWN) {
+        struct stat st;
+        if (fstatat(fd, name, &st, AT_SYMLINK_NOFOLLOW) != 0) {
+            return 1;
+        }
+        type = S_ISDIR(st.st_mode) ? DT_DIR : (S_ISREG(st.st_mode) ? DT_REG : DT_LNK);
+    }
+    if (type != DT_DIR && type != DT_REG) {
+        return 1;
+    }
+
+    char* path = walk_join(worker->arena, directory, name);
+    if (path == NULL) {
+        return 0;
+    }
+    if (type == DT_DIR) {
+        return walk_push(&worker->subdirectories, &worker->subdirectory_count, &worker->subdirectory_capacity, path);
+    }
+    return walk_push(&worker->paths, &worker->count, &worker->capacity, path);
+}
+
+/**
+ * @brief Lists one directory, collecting its files and subdirectories.
+ *
+ * @param worker The worker.
+ * @param directory The directory path.
+ * @return 1 on success, 0 on allocation failure.
+ */
+static int walk_list(WalkWorker* worker, const char* directory) {
+    int ok = 1;
+# ifdef __linux__
+    int fd = open(directory, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd < 0) {
+        printf("vcs: warning: could not read %s directory\n", directory);
+        return 1;
+    }
+    char* buffer = malloc(WALK_BUFFER_SIZE);
+    if (buffer == NULL) {
+        close(fd);
+        return 0;
+    }
+    long size;
+    while (ok && (size = syscall(SYS_getdents64, fd, buffer, WALK_BUFFER_SIZE)) > 0) {
+        for (long offset = 0; ok && offset < size;) {
+            struct linux_dirent64* entry = (struct linux_dirent64*)(buffer + offset);
+            ok = walk_entry(worker, fd, directory, entry->d_name, entry->d_type);
+            offset += entry->d_reclen;
+        }
+    }
+    free(buffer);
+    close(fd);
+# else
+    DIR* stream = opendir(directory);
+    if (stream == NULL) {
+        printf("vcs: warning: could not read %s directory\n", directory);
+        return 1;
+    }
+    struct dirent* entry;
+    while (ok && (entry = readdir(stream)) != NULL) {
+        ok = walk_entry(worker, dirfd(stream), directory, entry->d_name, entry->d_type);
+    }
+    closedir(stream);
+# endif
+    return ok;
+}
+
+/**
+ * @brief Lists directories from the queue until the walk is over.
+ *
+ * @param argument The worker.
+ * @return NULL.
+ */
+static void* walk_worker(void* argument) {
+    WalkWorker* worker = (WalkWorker*)argument;
+    WalkQueue* queue = worker->queue;
+
+    pthread_mutex_lock(&queue->lock);
+    for (;;) {
+        while (queue->count == 0 && queue->active > 0 && !queue->failed) {
+            pthread_cond_wait(&queue->ready, &queue->lock);
+        }
+        if (queue->count == 0 || queue->failed) {
+            break;
+        }
+        char* directory = queue->directories[--queue->count];
+        queue->active++;
+        pthread_mutex_unlock(&queue->lock);
+
+        worker->subdirectory_count = 0;
+        int ok = walk_list(worker, directory);
+
+        // queue the subdirectories in one batch
+        pthread_mutex_lock(&queue->lock);
+        for (size_t i = 0; ok && i < worker->subdirectory_count; i++) {
+            ok = walk_push(&queue->directories, &queue->count, &queue->capacity, worker->subdirectories[i]);
+        }
+        if (!ok) {
+            queue->failed = 1;
+        }
+        queue->active--;
+        pthread_cond_broadcast(&queue->ready);
+    }
+    pthread_mutex_unlock(&queue->lock);
+    return NULL;
+}
+
+/**
+ * @brief Writes a path in the form the walk produces for it.
+ *
+ * Empty and "." components are dropped, so "./d//x/" becomes "d/x", the
+ * same path walk_join builds for x under d. A path with no component left
+ * is ".", and absolute paths keep their leading slash.
+ *
+ * @param path The path as given.
+ * @param arena The arena that holds the returned path.
+ * @return The normalized path, or NULL on allocation failure.
+ */
+char* walk_normalize(const char* path, Arena* arena) {
+    size_t length = strlen(path);
+    char* normal = (char*)arena_alloc(arena, length + 2);
+    if (normal == NULL) {
+        return NULL;
+    }
+
+    size_t size = 0;
+    int absolute = (path[0] == '/');
+    if (absolute) {
+        normal[size++] = '/';
+    }
+    const char* cursor = path;
+    while (*cursor != '\0') {
+        const char* slash = strchr(cursor, '/');
+        size_t component = (slash != NULL) ? (size_t)(slash - cursor) : strlen(cursor);
+        if (component > 0 && !(component == 1 && cursor[0] == '.')) {
+            if (size > (size_t)absolute) {
+                normal[size++] = '/';
+            }
+            memcpy(normal + size, cursor, component);
+            size += component;
+        }
+        cursor += component + (slash != NULL);
+    }
+    if (size == 0) {
+        normal[size++] = '.';
+    }
+    normal[size] = '\0';
+    return normal;
+}
+
+/**
+ * @brief Orders paths bytewise, for qsort.
+ */
+static int walk_compare(const void* a, const void* b) {
+    return strcmp(*(char* const*)a, *(char* const*)b);
+}
+
+/**
+ * @brief Finds the regular files under a directory, recursively.
+ *
+ * Symbolic links are not followed, and the repository directory is skipped.
+ * Directories that cannot be read are reported and skipped.
+ *
+ * @param root The directory to walk.
+ * @param arena The arena that holds the returned paths.
+ * @param count Receives the number of paths.
+ * @return The paths in bytewise order, or NULL on allocation failure.
+ */
+char** walk_directory(const char* root, Arena* arena, size_t* count) {
+    *count = 0;
+
+    // drop trailing slashes, but keep the root directory itself
+    char* start = arena_strdup(arena, root);
+    if (start == NULL) {
+        return NULL;
+    }
+    for (size_t length = strlen(start); length > 1 && start[length - 1] == '/'; length--) {
+        start[length - 1] = '\0';
+    }
+
+    WalkQueue queue;
+    pthread_mutex_init(&queue.lock, NULL);
+    pthread_cond_init(&queue.ready, NULL);
+    queue.directories = NULL;
+    queue.count = 0;
+    queue.capacity = 0;
+    queue.active = 0;
+    queue.failed = !walk_push(&queue.directories, &queue.count, &queue.capacity, start);
+
+    long processors = sysconf(_SC_NPROCESSORS_ONLN);
+    size_t thread_count = (processors < 1) ? 1 : (size_t)processors;
+    if (thread_count > WALK_MAX_THREADS) {
+        thread_count = WALK_MAX_THREADS;
+    }
+
+    WalkWorker workers[WALK_MAX_THREADS];
+    size_t started = 0;
+    size_t threads = 0;
+    for (size_t i = 0; i < thread_count; i++) {
+        WalkWorker* worker = &workers[i];
+        memset(worker, 0, sizeof(*worker));
+        worker->queue = &queue;
+        worker->arena = arena_create();
+        if (worker->arena == NULL) {
+            break;
+        }
+        started++;
+        if (pthread_create(&worker->thread, NULL, walk_worker, worker) != 0) {
+            break;
+        }
+        threads++;
+    }
+
+    // walk on the calling thread if no thread could be started
+    if (threads == 0 && started > 0) {
+        walk_worker(&workers[0]);
+    }
+    for (size_t i = 0; i < threads; i++) {
+        pthread_join(workers[i].thread, NULL);
+    }
+
+    // copy the paths of every worker into the caller's arena
+    size_t total = 0;
+    for (size_t i = 0; i < started; i++) {
+        total += workers[i].count;
+    }
+    char** paths = (started > 0 && !queue.failed) ? (char**)arena_alloc(arena, (total + 1) * sizeof(char*)) : NULL;
+    for (size_t i = 0; i < started; i++) {
+        for (size_t j = 0; paths != NULL && j < workers[i].count; j++) {
+            paths[*count] = arena_strdup(arena, workers[i].paths[j]);
+            if (paths[*count] == NULL) {
+                paths = NULL;
+                break;
+            }
+            (*count)++;
+        }
+        free(workers[i].paths);
+        free(workers[i].subdirectories);
+        arena_destroy(workers[i].arena);
+    }
+    free(queue.directories);
+    pthread_cond_destroy(&queue.ready);
+    pthread_mutex_destroy(&queue.lock);
+
+    if (paths == NULL) {
+        *count = 0;
+        printf("vcs: error: could not allocate memory for walking %s\n", root);
+        return NULL;
+    }
+    qsort(paths, *count, sizeof(char*), walk_compare);
+    return paths;
+}
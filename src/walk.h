@@ -0,0 +1,16 @@
+# ifndef __WALK_H__
+# define __WALK_H__
+
+# include <stddef.h>
+
+# include "arena.h"
+
+/// Settings
+# define WALK_MAX_THREADS 8
+# define WALK_BUFFER_SIZE 32768
+
+// function prototypes
+char** walk_directory(const char* root, Arena* arena, size_t* count);
+char* walk_normalize(const char* path, Arena* arena);
+
+# endif